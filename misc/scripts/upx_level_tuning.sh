@@ -0,0 +1,136 @@
+#! /usr/bin/env bash
+## vim:set ts=4 sw=4 et:
+set -e; set -o pipefail
+
+# Copyright (C) Markus Franz Xaver Johannes Oberhumer
+#
+# measure the speed/ratio curve of the compression levels; requires:
+#   $upx_exe                     (required, but with convenience fallback "./upx")
+#   $upx_level_tuning_CORPUS     (required; directory with ELF/PE/Mach-O samples)
+#   $upx_level_tuning_BUILDDIR   (optional)
+#
+# optional settings:
+#   $upx_level_tuning_SWEEP=1    also sweep the LZMA encoder parameters and print
+#                                a new lzma_level_settings[] table (slow!)
+#
+# The output of the default mode is one line per method and level; the
+# levels should be monotonic: a higher level must never be both faster and
+# better, and it must never be slower and worse.
+# See lzma_level_settings[] in src/compress/compress_lzma.cpp and
+# zstd_level_settings[] in src/compress/compress_zstd.cpp.
+
+#***********************************************************************
+# init & checks
+#***********************************************************************
+
+[[ -z $upx_exe && -f ./upx && -x ./upx ]] && upx_exe=./upx # convenience fallback
+if [[ -z $upx_exe ]]; then echo "UPX-ERROR: please set \$upx_exe"; exit 1; fi
+if [[ ! -f $upx_exe ]]; then echo "UPX-ERROR: file '$upx_exe' does not exist"; exit 1; fi
+upx_exe=$(readlink -fn "$upx_exe") # make absolute
+if [[ ! -d $upx_level_tuning_CORPUS ]]; then
+    echo "UPX-ERROR: please set \$upx_level_tuning_CORPUS to a directory of sample files"
+    exit 1
+fi
+upx_level_tuning_CORPUS=$(readlink -fn "$upx_level_tuning_CORPUS") # make absolute
+[[ -z $upx_level_tuning_BUILDDIR ]] && upx_level_tuning_BUILDDIR="./tmp-upx-level-tuning"
+rm -rf "$upx_level_tuning_BUILDDIR"
+mkdir -p "$upx_level_tuning_BUILDDIR/packed"
+upx_level_tuning_BUILDDIR=$(readlink -fn "$upx_level_tuning_BUILDDIR") # make absolute
+cd / && cd "$upx_level_tuning_BUILDDIR" || exit 1
+
+# only use files that can actually be packed, so that all runs use the same inputs
+files=()
+while IFS= read -r -d '' f; do
+    if "$upx_exe" -qq -1 --no-filter "$f" -o ./probe.tmp >/dev/null 2>&1; then
+        files+=( "$f" )
+    fi
+    rm -f ./probe.tmp
+done < <(find "$upx_level_tuning_CORPUS" -type f -print0 | LC_ALL=C sort -z)
+if [[ ${#files[@]} == 0 ]]; then echo "UPX-ERROR: no packable files in corpus"; exit 1; fi
+u_bytes=0
+for f in "${files[@]}"; do u_bytes=$(( u_bytes + $(stat -c %s "$f") )); done
+echo "# corpus: ${#files[@]} files, $u_bytes bytes"
+
+# run_point LABEL UPX-OPTIONS...
+#   packs all files and prints "LABEL milliseconds packed_bytes ratio";
+#   a file that fails to pack would make the point look better, so that
+#   is an error
+run_point() {
+    local label="$1"; shift
+    local f i=0 t0 t1 c_bytes=0
+    rm -f ./packed/*
+    t0=$(date +%s%N)
+    for f in "${files[@]}"; do
+        i=$(( i + 1 ))
+        if ! "$upx_exe" -qq "$@" "$f" -o "./packed/$i" >/dev/null 2>&1; then
+            echo "UPX-ERROR: $label: cannot pack $f" >&2
+            exit 1
+        fi
+    done
+    t1=$(date +%s%N)
+    for f in ./packed/*; do
+        [[ -f $f ]] && c_bytes=$(( c_bytes + $(stat -c %s "$f") ))
+    done
+    printf '%-40s %9d %12d %8.4f\n' "$label" $(( (t1 - t0) / 1000000 )) $c_bytes \
+        "$(awk "BEGIN { print $c_bytes / $u_bytes }")"
+}
+
+# check_monotonic < "label ms bytes ratio" lines of one method
+check_monotonic() {
+    awk '{ if (NR > 1 && $2 < ms && $3 < bytes) print "WARNING: " $1 " is faster and better than the previous level";
+           if (NR > 1 && $2 > ms && $3 > bytes) print "WARNING: " $1 " is slower and worse than the previous level";
+           ms = $2; bytes = $3 }'
+}
+
+#***********************************************************************
+# levels
+#***********************************************************************
+
+methods=( --nrv2b --nrv2e --lzma )
+# zstd is disabled in default builds
+if "$upx_exe" -qq --zstd -1 "${files[0]}" -o ./probe.tmp >/dev/null 2>&1; then
+    methods+=( --zstd )
+else
+    echo "# --zstd is not supported by $upx_exe; skipped"
+fi
+rm -f ./probe.tmp
+
+for method in "${methods[@]}"; do
+    out="levels${method}.txt"
+    : > "$out"
+    for level in 1 2 3 4 5 6 7 8 9 best; do
+        run_point "${method#--}-$level" "$method" "--$level" | tee -a "$out"
+    done
+    check_monotonic < "$out"
+done
+
+#***********************************************************************
+# optional: sweep LZMA encoder parameters and suggest a new table
+#***********************************************************************
+
+if [[ $upx_level_tuning_SWEEP == 1 ]]; then
+    : > sweep.txt
+    for ds in 262144 1048576 4194304 16777216; do
+        for fm in 0 2; do
+            for fb in 8 32 64 128 273; do
+                run_point "ds=$ds,fm=$fm,fb=$fb" --lzma -9 \
+                    "--crp-lzma-ds=$ds" "--crp-lzma-fm=$fm" "--crp-lzma-fb=$fb" | tee -a sweep.txt
+            done
+        done
+    done
+    # Pareto frontier sorted by time; then pick 10 points evenly spaced in log(time)
+    echo "# suggested lzma_level_settings[] (Pareto frontier)"
+    LC_ALL=C sort -k2,2n -k3,3n sweep.txt | awk '
+        { if (NR == 1 || $3 < best) { best = $3; n++; label[n] = $1; ms[n] = ($2 > 0 ? $2 : 1) } }
+        END {
+            for (l = 1; l <= 10; l++) {
+                want = log(ms[1]) + (log(ms[n]) - log(ms[1])) * (l - 1) / 9
+                k = 1
+                for (i = 1; i <= n; i++) if (log(ms[i]) <= want) k = i
+                split(label[k], kv, /[=,]/)
+                printf("    {%u, %u, %u, 0}, // level %d\n", kv[2], kv[4], kv[6], l)
+            }
+        }'
+fi
+
+echo "All done."
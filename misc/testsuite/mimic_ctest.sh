@@ -73,6 +73,8 @@ fo="--force-overwrite"
 "${upx_run[@]}" -t         upx-packed${exe} upx-packed-n2b${exe} upx-packed-n2d${exe} upx-packed-n2e${exe} upx-packed-lzma${exe}
 "${upx_run[@]}" -d upx-packed${exe} ${fo} -o upx-unpacked${exe}
 
+upx_exe="$upx_exe" bash "$argv0dir/test_base.sh"
+
 set -x
 "${upx_runner[@]}" ./upx-unpacked${exe} --version-short
 "${upx_runner[@]}" ./upx-packed${exe} --version-short
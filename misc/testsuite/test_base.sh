@@ -0,0 +1,70 @@
+#! /usr/bin/env bash
+## vim:set ts=4 sw=4 et:
+set -e; set -o pipefail
+argv0=$0; argv0abs=$(readlink -fn "$argv0"); argv0dir=$(dirname "$argv0abs")
+
+#
+# Copyright (C) Markus Franz Xaver Johannes Oberhumer
+#
+# test "--base=FILE": pack a program, change one byte in the middle of it,
+# re-pack with --base and check that the result tests and unpacks to the
+# changed program; requires:
+#   $upx_exe                (required, but with convenience fallback "./upx")
+# optional settings:
+#   $upx_exe_runner         (e.g. "qemu-x86_64 -cpu Nehalem" or "valgrind")
+#
+
+# IMPORTANT NOTE: this script only works on Unix!!
+umask 0022
+
+#***********************************************************************
+# init & checks
+#***********************************************************************
+
+# upx_exe
+[[ -z $upx_exe && -f ./upx && -x ./upx ]] && upx_exe=./upx # convenience fallback
+if [[ -z $upx_exe ]]; then echo "UPX-ERROR: please set \$upx_exe"; exit 1; fi
+if [[ ! -f $upx_exe ]]; then echo "UPX-ERROR: file '$upx_exe' does not exist"; exit 1; fi
+upx_exe=$(readlink -fn "$upx_exe") # make absolute
+[[ -f $upx_exe ]] || exit 1
+upx_run=()
+if [[ -n $upx_exe_runner ]]; then
+    IFS=' ' read -r -a upx_run <<< "$upx_exe_runner" # split at spaces into array
+elif [[ -n $CMAKE_CROSSCOMPILING_EMULATOR ]]; then
+    IFS=';' read -r -a upx_run <<< "$CMAKE_CROSSCOMPILING_EMULATOR" # split at semicolons into array
+fi
+upx_run+=( "$upx_exe" )
+echo "upx_run='${upx_run[*]}'"
+
+export UPX="--no-color --no-progress"
+
+#***********************************************************************
+# main
+#***********************************************************************
+
+tmpdir="upx-test-base.tmp"
+rm -rf "./$tmpdir"
+mkdir "$tmpdir"
+cd "$tmpdir"
+
+# the old version, packed
+cp "$upx_exe" old.exe
+"${upx_run[@]}" -3 old.exe -o old.packed
+
+# the new version: one byte in the middle differs, so only one block changes
+cp old.exe new.exe
+size=$(wc -c < new.exe)
+offset=$(( size / 2 ))
+byte=$(od -An -tu1 -j $offset -N 1 new.exe | tr -d ' ')
+printf "\\$(printf %03o $(( byte ^ 0xff )))" | dd of=new.exe bs=1 seek=$offset count=1 conv=notrunc 2>/dev/null
+if cmp -s old.exe new.exe; then echo "UPX-ERROR: could not change new.exe"; exit 1; fi
+
+# re-pack with the old packed version as base, and check the round trip
+"${upx_run[@]}" -3 --base=old.packed new.exe -o new.packed
+"${upx_run[@]}" -t new.packed
+"${upx_run[@]}" -d new.packed -o new.unpacked
+if ! cmp -s new.exe new.unpacked; then echo "UPX-ERROR: new.unpacked differs from new.exe"; exit 1; fi
+
+cd ..
+rm -rf "./$tmpdir"
+echo "All done."
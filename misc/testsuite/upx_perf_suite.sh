@@ -0,0 +1,243 @@
+#! /usr/bin/env bash
+## vim:set ts=4 sw=4 et:
+set -e; set -o pipefail
+argv0=$0; argv0abs=$(readlink -fn "$argv0"); argv0dir=$(dirname "$argv0abs")
+
+#
+# Copyright (C) Markus Franz Xaver Johannes Oberhumer
+#
+# performance regression suite: generate a fixed synthetic corpus, then
+# pack, test and unpack it across methods, levels and filters, and compare
+# throughput, ratio and peak RSS against a stored baseline; requires:
+#   $upx_exe                    (required, but with convenience fallback "./upx")
+#   $CC                         (optional; default "cc"; builds the ELF inputs)
+#   $upx_perf_suite_BUILDDIR    (optional)
+#   $upx_perf_suite_BASELINE    (optional; default "$upx_perf_suite_BUILDDIR/baseline.txt")
+#
+# optional settings:
+#   $upx_perf_suite_EXTRA_CORPUS  directory with additional fixed inputs,
+#                                 e.g. real PE, Mach-O and vmlinuz files
+#   $upx_perf_suite_UPDATE=1      (re-)write the baseline instead of comparing
+#   $upx_perf_suite_RUNS          runs per measurement; the best one counts [default 3]
+#   $upx_perf_suite_TIME_PCT      allowed throughput loss in percent [default 10]
+#   $upx_perf_suite_RSS_PCT       allowed peak RSS growth in percent [default 10]
+#   $upx_perf_suite_RATIO_PCT     allowed ratio growth in percent    [default 0.5]
+#   $upx_perf_suite_CROSS_PE      (e.g. "x86_64-w64-mingw32-gcc") builds a PE input
+#
+# If the baseline does not exist it is written, and the run passes.
+# Ratios only depend on the inputs and the UPX version; throughput and
+# peak RSS depend on the machine, so keep one baseline per machine.
+#
+# The generated corpus only covers ELF executables and shared libraries
+# (and a PE file with $upx_perf_suite_CROSS_PE). Mach-O files and Linux
+# kernels (vmlinux/vmlinuz) are not covered unless real inputs are given
+# in $upx_perf_suite_EXTRA_CORPUS.
+#
+# A pack error fails the run, unless the baseline records the same input
+# and options as "cantpack"; that happens when an input cannot be packed
+# while the baseline is written.
+#
+
+#***********************************************************************
+# init & checks
+#***********************************************************************
+
+[[ -z $upx_exe && -f ./upx && -x ./upx ]] && upx_exe=./upx # convenience fallback
+if [[ -z $upx_exe ]]; then echo "UPX-ERROR: please set \$upx_exe"; exit 1; fi
+if [[ ! -f $upx_exe ]]; then echo "UPX-ERROR: file '$upx_exe' does not exist"; exit 1; fi
+upx_exe=$(readlink -fn "$upx_exe") # make absolute
+[[ -z $CC ]] && CC=cc
+[[ -z $upx_perf_suite_BUILDDIR ]] && upx_perf_suite_BUILDDIR="./tmp-upx-perf-suite"
+mkdir -p "$upx_perf_suite_BUILDDIR" || exit 1
+upx_perf_suite_BUILDDIR=$(readlink -fn "$upx_perf_suite_BUILDDIR") # make absolute
+[[ -z $upx_perf_suite_BASELINE ]] && upx_perf_suite_BASELINE="$upx_perf_suite_BUILDDIR/baseline.txt"
+upx_perf_suite_BASELINE=$(readlink -fn "$upx_perf_suite_BASELINE")
+[[ -z $upx_perf_suite_RUNS ]] && upx_perf_suite_RUNS=3
+[[ -z $upx_perf_suite_TIME_PCT ]] && upx_perf_suite_TIME_PCT=10
+[[ -z $upx_perf_suite_RSS_PCT ]] && upx_perf_suite_RSS_PCT=10
+[[ -z $upx_perf_suite_RATIO_PCT ]] && upx_perf_suite_RATIO_PCT=0.5
+cd / && cd "$upx_perf_suite_BUILDDIR" || exit 1
+rm -rf ./corpus ./work
+mkdir -p ./corpus ./work
+: > ./.mfxnobackup
+
+# peak RSS needs GNU time; without it RSS is reported as 0 and not compared
+time_exe=
+if /usr/bin/time -f %M true >/dev/null 2>&1; then time_exe=/usr/bin/time; fi
+
+#***********************************************************************
+# generate the corpus; all inputs are a pure function of this script
+#***********************************************************************
+
+# gen_data NAME BYTES SEED
+#   deterministic mix of text-like, tabular and random-looking bytes
+gen_data() {
+    awk -v n="$2" -v seed="$3" 'BEGIN {
+        split("the of and to in is for on that with by at from as this be are or", w, " ")
+        x = seed; out = 0
+        while (out < n) {
+            x = (x * 69069 + 1) % 4294967296 # exact in double precision
+            k = int(x / 65536) % 4
+            if (k <= 1) { s = w[1 + int(x / 7) % 18] " "; }
+            else if (k == 2) { s = sprintf("%08x\n", int(x / 3)); }
+            else { s = sprintf("%c%c%c", 33 + x % 90, 33 + int(x / 90) % 90, 33 + int(x / 8100) % 90); }
+            if (out + length(s) > n) s = substr(s, 1, n - out)
+            printf("%s", s); out += length(s)
+        }
+    }' > "$1"
+}
+
+# gen_c_source FILE BYTES SEED
+#   C source with a large initialized array, so the data ends up in PT_LOADs
+gen_c_source() {
+    local f="$1"
+    {
+        echo "/* generated by upx_perf_suite.sh; do not edit */"
+        echo "const unsigned char perf_data[] = {"
+        gen_data /dev/stdout "$2" "$3" | od -An -v -tu1 | sed -e 's/  */,/g' -e 's/^,//' -e 's/$/,/'
+        echo "};"
+        echo "unsigned perf_sum(unsigned n) { unsigned s = 0, i;"
+        echo "  for (i = 0; i < sizeof(perf_data) && i < n; i++) s = s * 31 + perf_data[i];"
+        echo "  return s; }"
+    } > "$f"
+}
+
+corpus_files=()
+gen_c_source ./work/data1.c $(( 3 * 1024 * 1024 )) 1
+gen_c_source ./work/data2.c $(( 1024 * 1024 )) 2
+echo 'unsigned perf_sum(unsigned); int main(int argc, char **argv) { (void) argv; return (int) (perf_sum((unsigned) argc) & 1); }' > ./work/main.c
+if command -v "$CC" >/dev/null 2>&1; then
+    if "$CC" -O2 -static -o ./corpus/elf-static ./work/main.c ./work/data1.c 2>/dev/null; then
+        corpus_files+=( ./corpus/elf-static )
+    fi
+    if "$CC" -O2 -fPIE -pie -o ./corpus/elf-pie ./work/main.c ./work/data1.c 2>/dev/null; then
+        corpus_files+=( ./corpus/elf-pie )
+    fi
+    if "$CC" -O2 -fPIC -shared -Wl,-init,perf_sum -o ./corpus/elf-shlib.so ./work/data2.c 2>/dev/null; then
+        corpus_files+=( ./corpus/elf-shlib.so )
+    fi
+else
+    echo "UPX-WARNING: no C compiler '$CC'; skipping the ELF inputs"
+fi
+if [[ -n $upx_perf_suite_CROSS_PE ]]; then
+    if "$upx_perf_suite_CROSS_PE" -O2 -o ./corpus/pe.exe ./work/main.c ./work/data2.c; then
+        corpus_files+=( ./corpus/pe.exe )
+    fi
+fi
+if [[ -n $upx_perf_suite_EXTRA_CORPUS ]]; then
+    while IFS= read -r -d '' f; do
+        corpus_files+=( "$f" )
+    done < <(find "$upx_perf_suite_EXTRA_CORPUS" -type f -print0 | LC_ALL=C sort -z)
+fi
+if [[ ${#corpus_files[@]} == 0 ]]; then echo "UPX-ERROR: empty corpus"; exit 1; fi
+
+#***********************************************************************
+# run
+#***********************************************************************
+
+# run_timed OUT_MS OUT_RSS CMD...
+#   runs CMD; sets the named variables to milliseconds and peak RSS in KiB
+run_timed() {
+    local -n ms_var=$1 rss_var=$2; shift 2
+    local t0 t1
+    t0=$(date +%s%N)
+    if [[ -n $time_exe ]]; then
+        "$time_exe" -f %M -o ./work/rss.txt "$@" >/dev/null 2>&1 || return 1
+        rss_var=$(tail -n 1 ./work/rss.txt)
+    else
+        "$@" >/dev/null 2>&1 || return 1
+        rss_var=0
+    fi
+    t1=$(date +%s%N)
+    ms_var=$(( (t1 - t0) / 1000000 ))
+    [[ $ms_var -gt 0 ]] || ms_var=1
+}
+
+# run_best OUT_MS OUT_RSS CMD...
+#   like run_timed, but runs CMD $upx_perf_suite_RUNS times and keeps the
+#   best time and the lowest peak RSS, so a single noisy run does not count
+run_best() {
+    local -n best_ms=$1 best_rss=$2; shift 2
+    local i r_ms r_rss
+    best_ms=0; best_rss=0
+    for (( i = 0; i < upx_perf_suite_RUNS; i++ )); do
+        run_timed r_ms r_rss "$@" || return 1
+        (( best_ms == 0 || r_ms < best_ms )) && best_ms=$r_ms
+        (( i == 0 || r_rss < best_rss )) && best_rss=$r_rss
+    done
+    return 0
+}
+
+writing_baseline=0
+[[ $upx_perf_suite_UPDATE == 1 || ! -f $upx_perf_suite_BASELINE ]] && writing_baseline=1
+
+# "name pack_MBps test_MBps unpack_MBps ratio peak_rss_KiB", or "name cantpack"
+result="./work/result.txt"
+: > "$result"
+for f in "${corpus_files[@]}"; do
+    u_bytes=$(stat -c %s "$f")
+    for method in --nrv2b --nrv2e --lzma; do
+        for level in 1 5 9; do
+            for filter in default --no-filter; do
+                name="$(basename "$f"):${method#--}-$level:${filter#--}"
+                opts=( "$method" "-$level" )
+                [[ $filter == default ]] || opts+=( "$filter" )
+                rm -f ./work/packed ./work/unpacked
+                if ! run_best p_ms p_rss "$upx_exe" -qq --force-overwrite "${opts[@]}" "$f" -o ./work/packed; then
+                    if [[ $writing_baseline == 1 ]]; then
+                        echo "UPX-WARNING: $name: cannot pack; recorded as cantpack in the baseline"
+                    elif awk -v n="$name" '$1 == n && $2 == "cantpack" { found = 1 } END { exit !found }' "$upx_perf_suite_BASELINE"; then
+                        echo "# $name: cannot pack, as in the baseline; skipped"
+                    else
+                        echo "UPX-ERROR: $name: pack failed"; exit 1
+                    fi
+                    printf "%-40s cantpack\n" "$name" >> "$result"
+                    continue
+                fi
+                run_best t_ms t_rss "$upx_exe" -qq -t ./work/packed || { echo "UPX-ERROR: $name: test failed"; exit 1; }
+                run_best d_ms d_rss "$upx_exe" -qq --force-overwrite -d ./work/packed -o ./work/unpacked || { echo "UPX-ERROR: $name: unpack failed"; exit 1; }
+                cmp -s "$f" ./work/unpacked || { echo "UPX-ERROR: $name: unpacked file differs"; exit 1; }
+                c_bytes=$(stat -c %s ./work/packed)
+                rss=$p_rss; (( t_rss > rss )) && rss=$t_rss; (( d_rss > rss )) && rss=$d_rss
+                awk -v n="$name" -v u="$u_bytes" -v c="$c_bytes" -v p="$p_ms" -v t="$t_ms" -v d="$d_ms" -v r="$rss" \
+                    'BEGIN { printf("%-40s %9.2f %9.2f %9.2f %8.4f %8d\n", n, u / p / 1000, u / t / 1000, u / d / 1000, c / u, r) }' \
+                    | tee -a "$result"
+            done
+        done
+    done
+done
+
+#***********************************************************************
+# compare against the baseline
+#***********************************************************************
+
+if [[ $writing_baseline == 1 ]]; then
+    cp "$result" "$upx_perf_suite_BASELINE"
+    echo "# baseline written to $upx_perf_suite_BASELINE"
+    echo "All done."
+    exit 0
+fi
+
+awk -v time_pct="$upx_perf_suite_TIME_PCT" -v rss_pct="$upx_perf_suite_RSS_PCT" -v ratio_pct="$upx_perf_suite_RATIO_PCT" '
+    function check(what, cur, base, pct, higher_is_worse) {
+        if (base <= 0 || cur <= 0) return
+        if (higher_is_worse ? cur > base * (1 + pct / 100) : cur < base * (1 - pct / 100)) {
+            printf("REGRESSION: %s %s %s -> %s (limit %s%%)\n", $1, what, base, cur, pct); bad++
+        }
+    }
+    FNR == NR { for (i = 2; i <= 6; i++) base[$1, i] = $i; next }
+    $2 == "cantpack" || base[$1, 2] == "cantpack" { next }
+    (($1, 2) in base) {
+        check("pack-MB/s",   $2, base[$1, 2], time_pct, 0)
+        check("test-MB/s",   $3, base[$1, 3], time_pct, 0)
+        check("unpack-MB/s", $4, base[$1, 4], time_pct, 0)
+        check("ratio",       $5, base[$1, 5], ratio_pct, 1)
+        check("peak-RSS",    $6, base[$1, 6], rss_pct, 1)
+        n++
+    }
+    END {
+        printf("# compared %d runs against the baseline: %d regressions\n", n, bad)
+        exit (bad > 0)
+    }' "$upx_perf_suite_BASELINE" "$result"
+
+echo "All done."
@@ -0,0 +1,322 @@
+/* dt_bench.cpp -- microbenchmarks of the internal kernels
+
+   This file is part of the UPX executable compressor.
+
+   Copyright (C) 1996-2024 Markus Franz Xaver Johannes Oberhumer
+   All Rights Reserved.
+
+   UPX and the UCL library are free software; you can redistribute them
+   and/or modify them under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of
+   the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; see the file COPYING.
+   If not, write to the Free Software Foundation, Inc.,
+   59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+
+   Markus F.X.J. Oberhumer
+   <markus@oberhumer.com>
+ */
+
+#include "../util/system_headers.h"
+#include <chrono>
+#include <cmath> // std::sqrt
+#include "../conf.h"
+#include "../filter.h"
+#include "../linker.h"
+#include "../util/membuffer.h"
+
+/*************************************************************************
+// upx_benchmark_internal() -- "upx --benchmark-internal"
+//
+// Times the hot kernels in isolation on fixed synthetic buffers, so that
+// an optimization of a single kernel can be evaluated without a full pack.
+// Each line reports the mean time per byte (or per item), the relative
+// standard deviation of the samples, and the fastest sample.
+// Use "-v" to include the slow compression levels.
+//
+// The output is meant for humans and is subject to change.
+**************************************************************************/
+
+namespace {
+
+constexpr unsigned BENCH_MIN_REPS = 3;
+constexpr unsigned BENCH_MAX_REPS = 25;
+constexpr double BENCH_BUDGET_NS = 250e6; // per kernel, after the warm-up run
+
+struct BenchRunner final {
+    FILE *f = nullptr;
+
+    // setup() is not timed; run() is timed; "units" is the number of bytes
+    // (or items) that one run() processes
+    template <class Setup, class Run>
+    void bench(const char *name, const char *unit, double units, Setup &&setup, Run &&run) {
+        typedef std::chrono::steady_clock clock;
+        double samples[BENCH_MAX_REPS];
+        unsigned n = 0;
+        double total_ns = 0;
+        setup();
+        run(); // warm-up: caches, page faults, lazy init
+        while (n < BENCH_MAX_REPS && (n < BENCH_MIN_REPS || total_ns < BENCH_BUDGET_NS)) {
+            setup();
+            const auto t0 = clock::now();
+            run();
+            const auto t1 = clock::now();
+            const double ns = (double) std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0)
+                                  .count();
+            samples[n++] = ns / units;
+            total_ns += ns;
+        }
+        double mean = 0, var = 0, best = samples[0];
+        for (unsigned i = 0; i < n; i++) {
+            mean += samples[i];
+            best = UPX_MIN(best, samples[i]);
+        }
+        mean /= n;
+        for (unsigned i = 0; i < n; i++)
+            var += (samples[i] - mean) * (samples[i] - mean);
+        const double rsd = mean > 0 ? 100.0 * std::sqrt(var / (n - 1)) / mean : 0.0;
+        con_fprintf(f, "  %-36s %10.3f ns/%-5s +-%5.1f%%  min %10.3f  n=%u\n", name, mean, unit,
+                    rsd, best, n);
+    }
+};
+
+// deterministic i386/amd64-like code: short instructions, mostly zero
+// high bytes, and E8/E9 calls and jumps to a limited set of targets
+static void fill_code(byte *b, unsigned len) {
+    unsigned x = 0x12345678;
+    unsigned i = 0;
+    while (i < len) {
+        x = x * 1103515245 + 12345;
+        const unsigned r = x >> 8;
+        if ((r & 7) == 0 && i + 5 <= len) {
+            b[i] = (r & 8) ? 0xe9 : 0xe8;
+            const unsigned target = ((r >> 4) & 1023) * 64;
+            set_le32(b + i + 1, target - (i + 5));
+            i += 5;
+        } else if ((r & 7) == 1 && i + 4 <= len) {
+            set_le32(b + i, (r >> 6) & 0xff); // small immediate
+            i += 4;
+        } else {
+            static const byte ops[16] = {0x48, 0x89, 0x8b, 0x83, 0xc3, 0x74, 0x75, 0x0f,
+                                         0x85, 0x31, 0xc0, 0x55, 0x5d, 0x90, 0xff, 0x00};
+            b[i++] = ops[(r >> 3) & 15];
+        }
+    }
+}
+
+// a linker with many relocations over one section; relocate() can be re-run
+class BenchLinker final : public ElfLinkerAMD64 {
+public:
+    void relocateAgain() {
+        reloc_done = false;
+        relocate();
+    }
+    unsigned getRelocationCount() const { return nrelocations; }
+};
+
+} // namespace
+
+void upx_benchmark_internal() {
+    BenchRunner br;
+    br.f = con_term;
+    const bool slow = opt->verbose >= 3; // "-v"; the default verbose level is 2
+
+    constexpr unsigned BIG = 1024 * 1024;  // checksums, filters, spans, decompression
+    constexpr unsigned SMALL = 256 * 1024; // compression
+    MemBuffer code(BIG), work(BIG), filtered(BIG);
+    fill_code(code, BIG);
+    byte *const code_ptr = raw_bytes(code, BIG);
+    byte *const work_ptr = raw_bytes(work, BIG);
+    auto nop = []() noexcept {};
+    unsigned volatile sink = 0;
+
+#if DEBUG
+    con_fprintf(br.f, "UPX internal benchmark (debug build; timings are not representative)\n");
+#else
+    con_fprintf(br.f, "UPX internal benchmark\n");
+#endif
+
+    // checksums
+    con_fprintf(br.f, "\nchecksums (%u KiB):\n", BIG / 1024);
+    br.bench("upx_adler32", "B", BIG, nop, [&]() { sink += upx_adler32(code_ptr, BIG); });
+    br.bench("upx_crc32", "B", BIG, nop, [&]() { sink += upx_crc32(code_ptr, BIG); });
+
+    // xspan versus raw pointers; the same byte-wise loop
+    con_fprintf(br.f, "\nbyte loop (%u KiB):\n", BIG / 1024);
+    br.bench("raw pointer", "B", BIG, nop, [&]() {
+        unsigned s = 0;
+        for (const byte *p = code_ptr; p != code_ptr + BIG; p++)
+            s += *p;
+        sink += s;
+    });
+    br.bench("SPAN_S checked", "B", BIG, nop, [&]() {
+        SPAN_S_VAR(const byte, s_ptr, code_ptr, BIG);
+        unsigned s = 0;
+        for (unsigned i = 0; i < BIG; i++)
+            s += s_ptr[i];
+        sink += s;
+    });
+
+    // filters: every FilterImpl entry via the public Filter interface
+    con_fprintf(br.f, "\nfilters (%u KiB; filter/unfilter/scan):\n", BIG / 1024);
+    for (int id = 1; id <= 255; id++) {
+        if (!Filter::isValidFilter(id))
+            continue;
+        char name[64];
+        Filter ft(opt->level);
+        bool ok = false;
+        try {
+            memcpy(work_ptr, code_ptr, BIG);
+            ft.init(id, 0);
+            ok = ft.filter(work_ptr, BIG);
+            memcpy(raw_bytes(filtered, BIG), work_ptr, BIG);
+        } catch (const Throwable &) {
+            ok = false;
+        }
+        if (!ok) {
+            con_fprintf(br.f, "  filter 0x%02x: not applicable to this buffer\n", id);
+            continue;
+        }
+        const Filter ft_done = ft; // keeps cto and friends for unfilter
+        upx_safe_snprintf(name, sizeof(name), "filter 0x%02x do_filter", id);
+        br.bench(
+            name, "B", BIG,
+            [&]() {
+                memcpy(work_ptr, code_ptr, BIG);
+                ft.init(id, 0);
+            },
+            [&]() { (void) ft.filter(work_ptr, BIG); });
+        upx_safe_snprintf(name, sizeof(name), "filter 0x%02x do_unfilter", id);
+        br.bench(
+            name, "B", BIG,
+            [&]() {
+                memcpy(work_ptr, raw_bytes(filtered, BIG), BIG);
+                ft = ft_done;
+            },
+            [&]() { ft.unfilter(work_ptr, BIG); });
+        upx_safe_snprintf(name, sizeof(name), "filter 0x%02x do_scan", id);
+        try {
+            ft.init(id, 0);
+            (void) ft.scan(code_ptr, BIG);
+            br.bench(
+                name, "B", BIG, [&]() { ft.init(id, 0); },
+                [&]() { (void) ft.scan(code_ptr, BIG); });
+        } catch (const Throwable &) {
+            con_fprintf(br.f, "  %-36s (no scan)\n", name);
+        }
+    }
+
+    // compression methods
+    static const int methods[] = {
+        M_NRV2B_LE32, M_NRV2D_LE32, M_NRV2E_LE32, M_LZMA, M_DEFLATE,
+#if (WITH_ZSTD)
+        M_ZSTD,
+#endif
+#if (WITH_BZIP2)
+        M_BZIP2,
+#endif
+    };
+    static const int fast_levels[] = {1, 5, 7};
+    static const int slow_levels[] = {1, 5, 7, 9, 10};
+    const int *const levels = slow ? slow_levels : fast_levels;
+    const unsigned nlevels = slow ? TABLESIZE(slow_levels) : TABLESIZE(fast_levels);
+    MemBuffer cbuf, dbuf, obuf;
+    cbuf.allocForCompression(SMALL);
+    dbuf.allocForDecompression(SMALL);
+    con_fprintf(br.f, "\ncompression (%u KiB; per uncompressed byte):\n", SMALL / 1024);
+    for (const int method : methods) {
+        for (unsigned il = 0; il < nlevels; il++) {
+            const int level = levels[il];
+            if (M_IS_LZMA(method) && level > 9)
+                continue;
+            char name[64];
+            upx_compress_result_t cresult;
+            unsigned c_len = 0;
+            int r = upx_compress(code_ptr, SMALL, raw_bytes(cbuf, cbuf.getSize()), &c_len, nullptr,
+                                 method, level, NULL_cconf, &cresult);
+            if (r != UPX_E_OK || c_len >= SMALL) {
+                con_fprintf(br.f, "  method %d level %d: not available\n", method, level);
+                continue;
+            }
+            upx_safe_snprintf(name, sizeof(name), "upx_compress   m=%-2d l=%-2d %6.2f%%", method,
+                              level, 100.0 * c_len / SMALL);
+            br.bench(
+                name, "B", SMALL, [&]() { c_len = 0; },
+                [&]() {
+                    (void) upx_compress(code_ptr, SMALL, raw_bytes(cbuf, cbuf.getSize()), &c_len,
+                                        nullptr, method, level, NULL_cconf, &cresult);
+                });
+            unsigned d_len = 0;
+            upx_safe_snprintf(name, sizeof(name), "upx_decompress m=%-2d l=%-2d", method, level);
+            br.bench(
+                name, "B", SMALL, [&]() { d_len = SMALL; },
+                [&]() {
+                    r = upx_decompress(raw_bytes(cbuf, c_len), c_len,
+                                       raw_bytes(dbuf, dbuf.getSize()), &d_len, method, &cresult);
+                });
+            if (r != UPX_E_OK || d_len != SMALL || memcmp(dbuf, code_ptr, SMALL) != 0)
+                throwInternalError("benchmark: decompression failed");
+
+            // in-place decompression check as done by Packer::findOverlapOverhead()
+            if (M_IS_DEFLATE(method))
+                continue; // no test_overlap for zlib
+            const unsigned overhead = SMALL / 8 + 512;
+            const unsigned src_off = SMALL + overhead - c_len;
+            obuf.dealloc();
+            obuf.alloc(SMALL + overhead);
+            memcpy(obuf + src_off, raw_bytes(cbuf, c_len), c_len);
+            upx_safe_snprintf(name, sizeof(name), "upx_test_overlap m=%-2d l=%-2d", method, level);
+            br.bench(
+                name, "B", SMALL, [&]() { d_len = SMALL; },
+                [&]() {
+                    r = upx_test_overlap(raw_bytes(obuf, SMALL + overhead), code_ptr, src_off,
+                                         c_len, &d_len, method, &cresult);
+                });
+            if (r != UPX_E_OK)
+                throwInternalError("benchmark: test_overlap failed");
+        }
+    }
+
+    // ElfLinker::relocate() of a synthetic stub
+    {
+        constexpr unsigned NRELOCS = 1024;
+        constexpr unsigned NSYMS = 16;
+        constexpr unsigned SECSIZE = 4 * NRELOCS;
+        MemBuffer stub(SECSIZE + 64 * (NRELOCS + NSYMS) + 256);
+        char *const p = (char *) raw_bytes(stub, stub.getSize());
+        memset(p, 0, SECSIZE);
+        const unsigned cap = stub.getSize();
+        unsigned len = SECSIZE;
+        len += upx_safe_snprintf(p + len, cap - len,
+                                 "Sections:\nIdx Name Size VMA LMA File off Algn\n"
+                                 "  0 CODE %08x 00000000 00000000 00000000 2**0\n"
+                                 "SYMBOL TABLE:\n",
+                                 SECSIZE);
+        for (unsigned i = 0; i < NSYMS; i++)
+            len += upx_safe_snprintf(p + len, cap - len, "%08x l       CODE 00000000 S%u\n",
+                                     i * (SECSIZE / NSYMS), i);
+        len += upx_safe_snprintf(p + len, cap - len,
+                                 "RELOCATION RECORDS FOR [CODE]:\n"
+                                 "OFFSET   TYPE              VALUE\n");
+        for (unsigned i = 0; i < NRELOCS; i++)
+            len += upx_safe_snprintf(p + len, cap - len, "%08x %-17s S%u\n", 4 * i,
+                                     (i & 1) ? "R_X86_64_PC32" : "R_X86_64_32", i % NSYMS);
+        BenchLinker linker;
+        linker.init(p, (int) len);
+        linker.addLoader("CODE");
+        con_fprintf(br.f, "\nlinker (%u relocations):\n", linker.getRelocationCount());
+        br.bench("ElfLinker::relocate", "reloc", linker.getRelocationCount(), nop,
+                 [&]() { linker.relocateAgain(); });
+    }
+
+    UNUSED(sink);
+}
+
+/* vim:set ts=4 sw=4 et: */
@@ -59,6 +59,22 @@ TEST_CASE("raw_bytes bounded array") {
     UNUSED(buf);
 }
 
+TEST_CASE("raw_region") {
+    upx_uint16_t buf[4] = {1, 2, 3, 4};
+    CHECK(raw_region(buf, 4) == buf);
+    CHECK_THROWS(raw_region(buf, 5));
+    upx_uint16_t *ptr = nullptr;
+    CHECK_NOTHROW(raw_region(ptr, 0));
+    CHECK_THROWS(raw_region(ptr, 1));
+#if WITH_XSPAN >= 2
+    SPAN_S_VAR(upx_uint16_t, s, buf, XSpanCount(4));
+    CHECK(raw_region(s, 4) == buf);
+    CHECK(raw_region(s + 1, 3)[2] == 4);
+    CHECK_THROWS(raw_region(s + 1, 4));
+#endif
+    UNUSED(ptr);
+}
+
 /*************************************************************************
 // basic xspan
 **************************************************************************/
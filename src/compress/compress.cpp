@@ -43,6 +43,40 @@ unsigned upx_adler32(const void *buf, unsigned len, unsigned adler) {
 #endif
 }
 
+// Combine adler1 of some data with adler2 of len2 bytes of following data
+// (where adler2 was started with the initial value 1) into the checksum of
+// the concatenation. Same math as zlib adler32_combine().
+unsigned upx_adler32_combine(unsigned adler1, unsigned adler2, upx_uint64_t len2) {
+    const unsigned BASE = 65521; // largest prime smaller than 65536
+    const unsigned rem = unsigned(len2 % BASE);
+    unsigned sum1 = adler1 & 0xffff;
+    unsigned sum2 = (rem * sum1) % BASE;
+    sum1 += (adler2 & 0xffff) + BASE - 1;
+    sum2 += (adler1 >> 16) + (adler2 >> 16) + BASE - rem;
+    if (sum1 >= BASE)
+        sum1 -= BASE;
+    if (sum1 >= BASE)
+        sum1 -= BASE;
+    if (sum2 >= 2 * BASE)
+        sum2 -= 2 * BASE;
+    if (sum2 >= BASE)
+        sum2 -= BASE;
+    return sum1 | (sum2 << 16);
+}
+
+TEST_CASE("upx_adler32_combine") {
+    byte buf[1024];
+    for (size_t i = 0; i < sizeof(buf); i++)
+        buf[i] = byte(i * 7 + (i >> 3));
+    const unsigned whole = upx_adler32(buf, sizeof(buf));
+    static const unsigned splits[] = {0, 1, 100, 1023, 1024};
+    for (unsigned split : splits) {
+        unsigned a1 = upx_adler32(buf, split);
+        unsigned a2 = upx_adler32(buf + split, sizeof(buf) - split);
+        CHECK(upx_adler32_combine(a1, a2, sizeof(buf) - split) == whole);
+    }
+}
+
 #if 0 // UNUSED
 unsigned upx_crc32(const void *buf, unsigned len, unsigned crc)
 {
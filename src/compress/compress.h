@@ -66,6 +66,9 @@ int upx_lzma_decompress    ( const upx_bytep src, unsigned  src_len,
                                    upx_bytep dst, unsigned *dst_len,
                                    int method,
                              const upx_compress_result_t *cresult );
+// set pb/lp/lc of lcconf to the best of a few fast trial compressions
+void upx_lzma_autotune     ( const upx_bytep src, unsigned  src_len,
+                             lzma_compress_config_t *lcconf );
 int upx_lzma_test_overlap  ( const upx_bytep buf,
                              const upx_bytep tbuf,
                                    unsigned  src_off, unsigned src_len,
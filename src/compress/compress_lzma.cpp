@@ -46,11 +46,13 @@ void lzma_compress_config_t::reset() noexcept {
     lit_pos_bits.reset();
     lit_context_bits.reset();
     dict_size.reset();
-    fast_mode = 2;
+    fast_mode.reset();
     num_fast_bytes.reset();
-    match_finder_cycles = 0;
+    match_finder_cycles.reset();
 
     max_num_probs = 0;
+    autotune = false;
+    abort_on_time_budget = false;
 }
 
 // INFO: the LZMA SDK is covered by a permissive license which allows
@@ -93,6 +95,33 @@ void lzma_compress_config_t::reset() noexcept {
 // compress defaults
 **************************************************************************/
 
+// Per-level encoder settings; levels 1..10 should be monotonic and well-spaced
+// points on the speed/ratio curve. Re-measure with "make upx-level-tuning"
+// (see misc/scripts/upx_level_tuning.sh) after changing any value here.
+// NOTE: all levels still use the settings of earlier UPX versions, so levels
+//   3..8 are identical; they are used by the testsuite checksums and as the
+//   defaults (7 for large files, 8 for small files). Only change a level
+//   together with the measurements which show that the new curve is better.
+struct LzmaLevelSettings final {
+    unsigned dict_size; // 0 means src_len
+    unsigned fast_mode;
+    unsigned num_fast_bytes;
+    unsigned match_finder_cycles; // 0 means encoder default
+};
+
+static const LzmaLevelSettings lzma_level_settings[10] = {
+    {256 * 1024, 0, 8, 0},         // level 1
+    {256 * 1024, 0, 64, 0},        // level 2
+    {4 * 1024 * 1024, 2, 64, 0},   // level 3
+    {4 * 1024 * 1024, 2, 64, 0},   // level 4
+    {4 * 1024 * 1024, 2, 64, 0},   // level 5
+    {4 * 1024 * 1024, 2, 64, 0},   // level 6
+    {4 * 1024 * 1024, 2, 64, 0},   // level 7
+    {4 * 1024 * 1024, 2, 64, 0},   // level 8
+    {8 * 1024 * 1024, 2, 64, 0},   // level 9
+    {0, 2, 64, 0},                 // level 10
+};
+
 static bool prepare_result(lzma_compress_result_t *res, unsigned src_len, int method, int level,
                            const lzma_compress_config_t *lcconf) {
     // setup defaults
@@ -123,37 +152,14 @@ static bool prepare_result(lzma_compress_result_t *res, unsigned src_len, int me
     res->lit_context_bits = 8;
 #endif
 
-    // TODO: tune these settings according to level
-    switch (level) {
-    case 1:
-        res->dict_size = 256 * 1024;
-        res->fast_mode = 0;
-        res->num_fast_bytes = 8;
-        break;
-    case 2:
-        res->dict_size = 256 * 1024;
-        res->fast_mode = 0;
-        break;
-    case 3:
-        break;
-    case 4:
-        break;
-    case 5:
-        break;
-    case 6:
-        break;
-    case 7:
-        break;
-    case 8:
-        break;
-    case 9:
-        res->dict_size = 8 * 1024 * 1024;
-        break;
-    case 10:
-        res->dict_size = src_len;
-        break;
-    default:
+    if (level < 1 || level > 10)
         goto error;
+    {
+        const LzmaLevelSettings &ls = lzma_level_settings[level - 1];
+        res->dict_size = ls.dict_size ? ls.dict_size : src_len;
+        res->fast_mode = ls.fast_mode;
+        res->num_fast_bytes = ls.num_fast_bytes;
+        res->match_finder_cycles = ls.match_finder_cycles;
     }
 
     // cconf overrides
@@ -162,7 +168,9 @@ static bool prepare_result(lzma_compress_result_t *res, unsigned src_len, int me
         oassign(res->lit_pos_bits, lcconf->lit_pos_bits);
         oassign(res->lit_context_bits, lcconf->lit_context_bits);
         oassign(res->dict_size, lcconf->dict_size);
+        oassign(res->fast_mode, lcconf->fast_mode);
         oassign(res->num_fast_bytes, lcconf->num_fast_bytes);
+        oassign(res->match_finder_cycles, lcconf->match_finder_cycles);
     }
 
     // limit dictionary size
@@ -191,7 +199,9 @@ static bool prepare_result(lzma_compress_result_t *res, unsigned src_len, int me
     lzma_compress_config_t::lit_pos_bits_t::assertValue(res->lit_pos_bits);
     lzma_compress_config_t::lit_context_bits_t::assertValue(res->lit_context_bits);
     lzma_compress_config_t::dict_size_t::assertValue(res->dict_size);
+    lzma_compress_config_t::fast_mode_t::assertValue(res->fast_mode);
     lzma_compress_config_t::num_fast_bytes_t::assertValue(res->num_fast_bytes);
+    lzma_compress_config_t::match_finder_cycles_t::assertValue(res->match_finder_cycles);
 
     res->num_probs = 1846 + (768u << (res->lit_context_bits + res->lit_pos_bits));
     NO_printf("\nlzma_compress config: %u %u %u %u %u\n", res->pos_bits, res->lit_pos_bits,
@@ -294,11 +304,15 @@ struct ProgressInfo final : public ICompressProgressInfo, public CMyUnknownImp {
     MY_UNKNOWN_IMP
     STDMETHOD(SetRatioInfo)(const UInt64 *inSize, const UInt64 *outSize) override;
     upx_callback_t *cb = nullptr;
+    bool abort_on_time_budget = false; // from lzma_compress_config_t
 };
 
 STDMETHODIMP ProgressInfo::SetRatioInfo(const UInt64 *inSize, const UInt64 *outSize) {
     if (cb && cb->nprogress)
         cb->nprogress(cb, (unsigned) *inSize, (unsigned) *outSize);
+    // "--time-budget-hard": stop right away; see upx_lzma_compress()
+    if (abort_on_time_budget && upx_time_budget_expired())
+        return E_ABORT;
     return S_OK;
 }
 
@@ -316,6 +330,75 @@ STDMETHODIMP ProgressInfo::SetRatioInfo(const UInt64 *inSize, const UInt64 *outS
 #include <lzma-sdk/C/7zip/Compress/RangeCoder/RangeCoderBit.cpp>
 #undef RC_NORMALIZE
 
+/*************************************************************************
+// autotune - estimate the best (pb, lp, lc) for a block by running fast
+// trial compressions over a few evenly spaced sample windows
+**************************************************************************/
+
+void upx_lzma_autotune(const upx_bytep src, unsigned src_len, lzma_compress_config_t *lcconf) {
+    // candidate (pb, lp, lc) - the first entry is the UPX default
+    static const byte candidates[][3] = {
+        {2, 0, 3}, // default
+        {0, 0, 3}, // byte-oriented code (i386, amd64)
+        {0, 0, 4}, // byte-oriented code with more literal context
+        {1, 1, 3}, // 2-byte aligned code and data (thumb, m68k)
+        {1, 1, 2}, //
+        {2, 2, 0}, // 4-byte aligned instructions (arm64, ppc, mips)
+        {2, 2, 1}, //
+        {2, 0, 0}, // tables and other structured data
+    };
+    const unsigned window_size = 32 * 1024;
+    const unsigned num_windows = 4;
+    if (src_len < 2 * window_size)
+        return; // not worth it
+
+    // build the sample buffer
+    MemBuffer sample;
+    unsigned sample_len = window_size * num_windows;
+    if (sample_len >= src_len) {
+        sample_len = src_len;
+        sample.alloc(sample_len);
+        memcpy(sample, src, sample_len);
+    } else {
+        sample.alloc(sample_len);
+        const unsigned step = (src_len - window_size) / (num_windows - 1);
+        for (unsigned i = 0; i < num_windows; i++)
+            memcpy(sample + i * window_size, src + i * step, window_size);
+    }
+    MemBuffer trial;
+    trial.allocForCompression(sample_len);
+
+    upx_compress_config_t tconf;
+    tconf.reset();
+    // trials use the fast encoder (level 1); only the relative order matters
+    tconf.conf_lzma.num_fast_bytes = 32;
+    unsigned best_len = UINT_MAX;
+    const byte *best = nullptr;
+    for (const auto &c : candidates) {
+        if (lcconf->max_num_probs && 1846 + (768u << (c[1] + c[2])) > lcconf->max_num_probs)
+            continue;
+        tconf.conf_lzma.pos_bits = c[0];
+        tconf.conf_lzma.lit_pos_bits = c[1];
+        tconf.conf_lzma.lit_context_bits = c[2];
+        unsigned trial_len = trial.getSize();
+        upx_compress_result_t tresult;
+        int r = upx_lzma_compress(raw_bytes(sample, sample_len), sample_len,
+                                  raw_bytes(trial, trial_len), &trial_len, nullptr, M_LZMA, 1,
+                                  &tconf, &tresult);
+        if (r == UPX_E_OK && trial_len < best_len) {
+            best_len = trial_len;
+            best = c;
+        }
+    }
+    if (best == nullptr)
+        return;
+    lcconf->pos_bits = best[0];
+    lcconf->lit_pos_bits = best[1];
+    lcconf->lit_context_bits = best[2];
+    NO_printf("\nlzma_autotune: %u: pb=%u lp=%u lc=%u -> %u\n", src_len, best[0], best[1], best[2],
+              best_len);
+}
+
 int upx_lzma_compress(const upx_bytep src, unsigned src_len, upx_bytep dst, unsigned *dst_len,
                       upx_callback_t *cb, int method, int level,
                       const upx_compress_config_t *cconf_parm, upx_compress_result_t *cresult) {
@@ -325,10 +408,22 @@ int upx_lzma_compress(const upx_bytep src, unsigned src_len, upx_bytep dst, unsi
 
     int r = UPX_E_ERROR;
     HRESULT rh;
-    const lzma_compress_config_t *const lcconf = cconf_parm ? &cconf_parm->conf_lzma : nullptr;
+    const lzma_compress_config_t *lcconf = cconf_parm ? &cconf_parm->conf_lzma : nullptr;
     lzma_compress_result_t *const res = &cresult->result_lzma;
     res->reset();
 
+    // autotune pb/lp/lc unless explicitly requested by method or cconf; the
+    // chosen values are stored in the 2-byte stream header and in cresult,
+    // so every block is self-describing for the decompressor
+    lzma_compress_config_t lcconf_autotune;
+    if (lcconf && lcconf->autotune && method < 0x100 && !lcconf->pos_bits.is_set &&
+        !lcconf->lit_pos_bits.is_set && !lcconf->lit_context_bits.is_set) {
+        lcconf_autotune = *lcconf;
+        lcconf_autotune.autotune = false;
+        upx_lzma_autotune(src, src_len, &lcconf_autotune);
+        lcconf = &lcconf_autotune;
+    }
+
     MyLzma::InStream is;
     is.AddRef();
     is.Init(src, src_len);
@@ -338,6 +433,7 @@ int upx_lzma_compress(const upx_bytep src, unsigned src_len, upx_bytep dst, unsi
     MyLzma::ProgressInfo progress;
     progress.AddRef();
     progress.cb = cb; // progress.Init()
+    progress.abort_on_time_budget = lcconf && lcconf->abort_on_time_budget;
 
     NCompress::NLZMA::CEncoder enc;
     const PROPID propIDs[8] = {
@@ -405,6 +501,8 @@ int upx_lzma_compress(const upx_bytep src, unsigned src_len, upx_bytep dst, unsi
     } else if (rh == S_OK) {
         assert(is.b_pos == src_len);
         r = UPX_E_OK;
+    } else if (rh == E_ABORT) {
+        upx_time_budget_check(); // throws
     }
 
 error:
@@ -551,4 +649,59 @@ TEST_CASE("upx_lzma_decompress") {
     UNUSED(r);
 }
 
+// compress u_buf with --lzma-autotune, check the chosen pb/lp/lc in cresult
+// and in the 2-byte stream header, and decompress again
+static void test_lzma_autotune(MemBuffer &u_buf, unsigned max_num_probs,
+                               lzma_compress_result_t *res) {
+    const unsigned u_len = u_buf.getSize();
+    MemBuffer c_buf, d_buf(u_len);
+    c_buf.allocForCompression(u_len);
+    upx_compress_config_t cconf;
+    cconf.reset();
+    cconf.conf_lzma.autotune = true;
+    cconf.conf_lzma.max_num_probs = max_num_probs;
+    upx_compress_result_t cresult;
+    unsigned c_len = c_buf.getSize();
+    int r = upx_lzma_compress(raw_bytes(u_buf, u_len), u_len, raw_bytes(c_buf, c_len), &c_len,
+                              nullptr, M_LZMA, 2, &cconf, &cresult);
+    CHECK(r == 0);
+    *res = cresult.result_lzma;
+    if (max_num_probs)
+        CHECK(res->num_probs <= max_num_probs);
+    CHECK(c_buf[0] == (((res->lit_context_bits + res->lit_pos_bits) << 3) | res->pos_bits));
+    CHECK(c_buf[1] == ((res->lit_pos_bits << 4) | res->lit_context_bits));
+    unsigned d_len = u_len;
+    r = upx_lzma_decompress(raw_bytes(c_buf, c_len), c_len, raw_bytes(d_buf, d_len), &d_len,
+                            M_LZMA, nullptr);
+    CHECK((r == 0 && d_len == u_len));
+    CHECK(memcmp(u_buf, d_buf, u_len) == 0);
+}
+
+TEST_CASE("upx_lzma_compress autotune") {
+    const unsigned u_len = 128 * 1024;
+    MemBuffer u_buf(u_len);
+    lzma_compress_result_t res;
+    upx_uint32_t x = 0x12345678;
+
+    // 4-byte records: the low 5 bits of each byte only depend on its position
+    // in the record, and the random high 3 bits hide it from lc; so lp = 2
+    static const byte low_bits[4] = {0x03, 0x11, 0x0c, 0x1e};
+    for (unsigned i = 0; i < u_len; i++) {
+        x = x * 1103515245 + 12345;
+        u_buf[i] = byte(((x >> 24) & 0xe0) | low_bits[i & 3]);
+    }
+    test_lzma_autotune(u_buf, 1846 + (768 << 3), &res);
+    CHECK(res.pos_bits == 2);
+    CHECK(res.lit_pos_bits == 2);
+
+    // text-like bytes from 3 classes in turn: the high 3 bits of the previous
+    // byte give the class of the next one, while the position does not; so lc >= 3
+    for (unsigned i = 0; i < u_len; i++) {
+        x = x * 1103515245 + 12345;
+        u_buf[i] = byte((0x20 * (1 + i % 3)) | ((x >> 24) & 0x1f));
+    }
+    test_lzma_autotune(u_buf, 0, &res);
+    CHECK(res.lit_context_bits >= 3);
+}
+
 /* vim:set ts=4 sw=4 et: */
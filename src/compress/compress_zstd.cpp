@@ -54,9 +54,31 @@ static int convert_errno_from_zstd(size_t zr) {
 }
 
 /*************************************************************************
-// TODO later: use advanced compression API for compression finetuning
+// map UPX level 1..10 to zstd parameters
 **************************************************************************/
 
+// NOTE: these are the zstd levels of earlier UPX versions (1..9, and 22 for
+//   level 10); only change them together with measurements from
+//   "make upx-level-tuning" (see misc/scripts/upx_level_tuning.sh).
+struct ZstdLevelSettings final {
+    int level;      // zstd-level 1..22
+    int strategy;   // ZSTD_strategy, 0 means default for level
+    int window_log; // 0 means default for level and src_len
+};
+
+static const ZstdLevelSettings zstd_level_settings[10] = {
+    {1, 0, 0},  // level 1
+    {2, 0, 0},  // level 2
+    {3, 0, 0},  // level 3
+    {4, 0, 0},  // level 4
+    {5, 0, 0},  // level 5
+    {6, 0, 0},  // level 6
+    {7, 0, 0},  // level 7
+    {8, 0, 0},  // level 8
+    {9, 0, 0},  // level 9
+    {22, 0, 0}, // level 10
+};
+
 int upx_zstd_compress(const upx_bytep src, unsigned src_len, upx_bytep dst, unsigned *dst_len,
                       upx_callback_t *cb_parm, int method, int level,
                       const upx_compress_config_t *cconf_parm, upx_compress_result_t *cresult) {
@@ -70,16 +92,26 @@ int upx_zstd_compress(const upx_bytep src, unsigned src_len, upx_bytep dst, unsi
     zstd_compress_result_t *const res = &cresult->result_zstd;
     res->reset();
 
-    // TODO later: map level 1..10 to zstd-level 1..22
-    if (level == 10)
-        level = 22;
+    if (level < 1 || level > 10)
+        return UPX_E_INVALID_ARGUMENT;
+    const ZstdLevelSettings &ls = zstd_level_settings[level - 1];
 
     // cconf overrides
     if (lcconf) {
         UNUSED(lcconf);
     }
 
-    zr = ZSTD_compress(dst, *dst_len, src, src_len, level);
+    ZSTD_CCtx *const cctx = ZSTD_createCCtx();
+    if (cctx == nullptr)
+        return UPX_E_OUT_OF_MEMORY;
+    zr = ZSTD_CCtx_setParameter(cctx, ZSTD_c_compressionLevel, ls.level);
+    if (!ZSTD_isError(zr) && ls.strategy != 0)
+        zr = ZSTD_CCtx_setParameter(cctx, ZSTD_c_strategy, ls.strategy);
+    if (!ZSTD_isError(zr) && ls.window_log != 0)
+        zr = ZSTD_CCtx_setParameter(cctx, ZSTD_c_windowLog, ls.window_log);
+    if (!ZSTD_isError(zr))
+        zr = ZSTD_compress2(cctx, dst, *dst_len, src, src_len);
+    ZSTD_freeCCtx(cctx);
     if (ZSTD_isError(zr)) {
         *dst_len = 0; // TODO ???
         r = convert_errno_from_zstd(zr);
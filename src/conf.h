@@ -659,17 +659,21 @@ struct lzma_compress_config_t final {
     typedef OptVar<unsigned, 0u, 0u, 4u> lit_pos_bits_t;     // lp
     typedef OptVar<unsigned, 3u, 0u, 8u> lit_context_bits_t; // lc
     typedef OptVar<unsigned, (1u << 22), 1u, (1u << 30)> dict_size_t;
+    typedef OptVar<unsigned, 2u, 0u, 2u> fast_mode_t;
     typedef OptVar<unsigned, 64u, 5u, 273u> num_fast_bytes_t;
+    typedef OptVar<unsigned, 0u, 0u, 1000u> match_finder_cycles_t;
 
     pos_bits_t pos_bits;                 // pb
     lit_pos_bits_t lit_pos_bits;         // lp
     lit_context_bits_t lit_context_bits; // lc
     dict_size_t dict_size;
-    unsigned fast_mode;
+    fast_mode_t fast_mode;
     num_fast_bytes_t num_fast_bytes;
-    unsigned match_finder_cycles;
+    match_finder_cycles_t match_finder_cycles;
 
     unsigned max_num_probs;
+    bool autotune; // estimate pb/lp/lc from sampled trial compressions
+    bool abort_on_time_budget; // "--time-budget-hard": stop once the budget is used up
 
     void reset() noexcept;
 };
@@ -798,6 +802,8 @@ unsigned membuffer_get_size(MemBuffer &mb) noexcept;
 noinline void upx_compiler_sanity_check() noexcept;
 noinline int upx_doctest_check(int argc, char **argv);
 int upx_doctest_check();
+// check/dt_bench.cpp
+void upx_benchmark_internal();
 
 // main.cpp
 extern const char *progname;
@@ -836,6 +842,7 @@ void show_version(bool one_line = false);
 // compress/compress.cpp
 // clang-format off
 unsigned upx_adler32(const void *buf, unsigned len, unsigned adler = 1);
+unsigned upx_adler32_combine(unsigned adler1, unsigned adler2, upx_uint64_t len2);
 unsigned upx_crc32  (const void *buf, unsigned len, unsigned crc = 0);
 
 int upx_compress           ( const upx_bytep src, unsigned  src_len,
@@ -205,6 +205,7 @@ void show_help(int verbose) {
         fg = con_fg(f, fg);
         con_fprintf(f,
                     "  --lzma              try LZMA [slower but tighter than NRV]\n"
+                    "  --lzma-autotune     use LZMA and tune lc/lp/pb for each block\n"
                     "  --brute             try all available compression methods & filters [slow]\n"
                     "  --ultra-brute       try even more compression variants [very slow]\n"
                     "\n");
@@ -216,6 +217,13 @@ void show_help(int verbose) {
                     "  --no-backup         no backup files [default]\n"
                     "\n");
         fg = con_fg(f, FG_YELLOW);
+        con_fprintf(f, "List options (for -l and --fileinfo):\n");
+        fg = con_fg(f, fg);
+        con_fprintf(f,
+                    "  --header-only       only read the UPX header [fast]\n"
+                    "  --json              print one JSON object per file; implies --header-only\n"
+                    "\n");
+        fg = con_fg(f, FG_YELLOW);
         con_fprintf(f, "Overlay options:\n");
         fg = con_fg(f, fg);
         con_fprintf(f,
@@ -237,6 +245,19 @@ void show_help(int verbose) {
                     "  --no-time           do not preserve file timestamp\n"
                     "\n");
         fg = con_fg(f, FG_YELLOW);
+        con_fprintf(f, "Performance options:\n");
+        fg = con_fg(f, fg);
+        con_fprintf(f,
+#if (WITH_THREADS)
+                    "  --threads=N         use N worker threads [default: one per CPU]\n"
+#endif
+                    "  --max-memory=N      tune block sizes for about N MiB (a hint, not a limit)\n"
+                    "  --cache-dir=DIR     reuse packed files from DIR, and add new ones\n"
+                    "  --cache-size=N      limit the size of the cache to N MiB [default: 1024]\n"
+                    "  --time-budget=N     stop searching for better compression after N seconds\n"
+                    "  --time-budget-hard  ...and fail instead of using the best result so far\n"
+                    "\n");
+        fg = con_fg(f, FG_YELLOW);
         con_fprintf(f, "Options for djgpp2/coff:\n");
         fg = con_fg(f, fg);
         con_fprintf(f,
@@ -296,6 +317,7 @@ void show_help(int verbose) {
         fg = con_fg(f, fg);
         con_fprintf(f,
                     "  --preserve-build-id     copy .gnu.note.build-id to compressed output\n"
+                    "  --base=FILE             reuse unchanged blocks of an older packed FILE\n"
                     "\n");
     }
     // clang-format on
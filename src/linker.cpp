@@ -117,43 +117,233 @@ ElfLinker::~ElfLinker() noexcept {
     for (ic = 0; ic < nrelocations; ic++)
         delete relocations[ic];
     free(relocations);
+    free(section_hash);
+    free(symbol_hash);
+}
+
+/*************************************************************************
+// name lookup
+//
+// Sections and symbols are indexed by name in a power-of-two sized
+// open-addressing table of object pointers (and not of indices, because
+// ImportLinker::build() sorts the sections[] array in place).
+// The load factor is kept at or below 1/2.
+**************************************************************************/
+
+static inline unsigned name_hash(const char *name) noexcept {
+    unsigned h = 0x811c9dc5; // FNV-1a
+    for (; *name; name++)
+        h = (h ^ (uchar) *name) * 0x01000193;
+    return h;
+}
+
+template <class T>
+static T *name_hash_find(T *const *table, unsigned mask, const char *name) noexcept {
+    if (table == nullptr)
+        return nullptr;
+    for (unsigned i = name_hash(name) & mask;; i = (i + 1) & mask) {
+        T *obj = table[i];
+        if (obj == nullptr || strcmp(obj->name, name) == 0)
+            return obj;
+    }
+}
+
+template <class T>
+static void name_hash_insert(T **table, unsigned mask, T *obj) noexcept {
+    unsigned i = name_hash(obj->name) & mask;
+    while (table[i] != nullptr)
+        i = (i + 1) & mask;
+    table[i] = obj;
+}
+
+// add objs[n-1] to the table, growing and rehashing objs[0..n-1] when needed
+template <class T>
+static void name_hash_add(T **&table, unsigned &mask, T *const *objs, unsigned n) {
+    if (table != nullptr && 2 * n <= mask + 1) {
+        name_hash_insert(table, mask, objs[n - 1]);
+        return;
+    }
+    unsigned size = 16;
+    while (size < 4 * n)
+        size *= 2;
+    free(table);
+    table = (T **) calloc(size, sizeof(T *));
+    assert(table != nullptr);
+    mask = size - 1;
+    for (unsigned ic = 0; ic < n; ic++)
+        name_hash_insert(table, mask, objs[ic]);
+}
+
+/*************************************************************************
+// process-wide cache of parsed stubs
+//
+// Every buildLoader() - i.e. every compression trial - calls init();
+// decompressing the stub and parsing its objdump listing is only done
+// once per stub, later calls just copy the parsed tables.
+// The cached images are immutable and live until the program exits.
+**************************************************************************/
+
+struct ElfLinker::StubImage final : private noncopyable {
+    StubImage *next = nullptr;
+    const void *pdata = nullptr; // key
+    int plen = 0;                // key
+    unsigned adler = 0;          // key; in case pdata is not a static stub
+    ElfLinker proto;             // linker state right after parsing
+    unsigned *rel_symbol = nullptr; // index of the symbol of each relocation
+    ~StubImage() noexcept { free(rel_symbol); }
+};
+
+ElfLinker::StubImage *ElfLinker::stub_images = nullptr;
+#if WITH_THREADS
+static std::mutex stub_images_mutex;
+#endif
+
+/*static*/ const ElfLinker::StubImage *ElfLinker::findStubImage(const void *pdata, int plen,
+                                                               unsigned adler) {
+#if WITH_THREADS
+    std::lock_guard<std::mutex> lock(stub_images_mutex);
+#endif
+    for (const StubImage *image = stub_images; image != nullptr; image = image->next)
+        if (image->pdata == pdata && image->plen == plen && image->adler == adler)
+            return image;
+    return nullptr;
+}
+
+void ElfLinker::addStubImage(const void *pdata, int plen, unsigned adler) {
+    StubImage *image = new StubImage;
+    image->pdata = pdata;
+    image->plen = plen;
+    image->adler = adler;
+    image->rel_symbol = (unsigned *) malloc(mem_size(sizeof(unsigned), nrelocations + 1));
+    assert(image->rel_symbol != nullptr);
+    for (unsigned ic = 0; ic < nrelocations; ic++) {
+        unsigned is = 0;
+        while (symbols[is] != relocations[ic]->value)
+            is++;
+        image->rel_symbol[ic] = is;
+    }
+    image->proto.copyStubTables(this, image->rel_symbol);
+#if WITH_THREADS
+    std::lock_guard<std::mutex> lock(stub_images_mutex);
+#endif
+    image->next = stub_images;
+    stub_images = image;
+}
+
+// copy input, sections, symbols and relocations; as for the objects
+// created by addSection(), addSymbol() and addRelocation()
+void ElfLinker::copyStubTables(const ElfLinker *from, const unsigned *rel_symbol) {
+    assert(input == nullptr && nsections == 0 && nsymbols == 0 && nrelocations == 0);
+    inputlen = from->inputlen;
+    input = New(byte, inputlen + 1);
+    memcpy(input, from->input, inputlen + 1);
+
+    nsections_capacity = from->nsections_capacity;
+    nsymbols_capacity = from->nsymbols_capacity;
+    nrelocations_capacity = from->nrelocations_capacity;
+    if (nsections_capacity) {
+        sections = (Section **) malloc(mem_size(sizeof(Section *), nsections_capacity));
+        assert(sections != nullptr);
+    }
+    if (nsymbols_capacity) {
+        symbols = (Symbol **) malloc(mem_size(sizeof(Symbol *), nsymbols_capacity));
+        assert(symbols != nullptr);
+    }
+    if (nrelocations_capacity) {
+        relocations =
+            (Relocation **) malloc(mem_size(sizeof(Relocation *), nrelocations_capacity));
+        assert(relocations != nullptr);
+    }
+
+    for (; nsections < from->nsections; nsections++) {
+        const Section *sec = from->sections[nsections];
+        assert(sec->sort_id == nsections);
+        sections[nsections] = new Section(sec->name, sec->input, sec->size, sec->p2align);
+        sections[nsections]->sort_id = nsections;
+        name_hash_add(section_hash, section_hash_mask, sections, nsections + 1);
+    }
+    for (; nsymbols < from->nsymbols; nsymbols++) {
+        const Symbol *sym = from->symbols[nsymbols];
+        symbols[nsymbols] = new Symbol(sym->name, sections[sym->section->sort_id], sym->offset);
+        name_hash_add(symbol_hash, symbol_hash_mask, symbols, nsymbols + 1);
+    }
+    for (; nrelocations < from->nrelocations; nrelocations++) {
+        const Relocation *rel = from->relocations[nrelocations];
+        // the relocation type points into the preprocessed input
+        const char *type = rel->type;
+        if (type >= (const char *) from->input && type < (const char *) from->input + inputlen)
+            type = (const char *) input + (type - (const char *) from->input);
+        relocations[nrelocations] =
+            new Relocation(sections[rel->section->sort_id], rel->offset, type,
+                           symbols[rel_symbol[nrelocations]], rel->add);
+    }
 }
 
 void ElfLinker::init(const void *pdata_v, int plen, unsigned pxtra) {
-    const byte *pdata = (const byte *) pdata_v;
-    if (plen >= 16 && memcmp(pdata, "UPX#", 4) == 0) {
-        // decompress pre-compressed stub-loader
-        int method;
-        unsigned u_len, c_len;
-        if (pdata[4]) {
-            method = pdata[4];
-            u_len = get_le16(pdata + 5);
-            c_len = get_le16(pdata + 7);
-            pdata += 9;
-            assert(9 + c_len == (unsigned) plen);
+    const unsigned adler = upx_adler32(pdata_v, plen);
+    const StubImage *image = findStubImage(pdata_v, plen, adler);
+    if (image != nullptr) {
+        copyStubTables(&image->proto, image->rel_symbol);
+    } else {
+        const byte *pdata = (const byte *) pdata_v;
+        if (plen >= 16 && memcmp(pdata, "UPX#", 4) == 0) {
+            // decompress pre-compressed stub-loader
+            int method;
+            unsigned u_len, c_len;
+            if (pdata[4]) {
+                method = pdata[4];
+                u_len = get_le16(pdata + 5);
+                c_len = get_le16(pdata + 7);
+                pdata += 9;
+                assert(9 + c_len == (unsigned) plen);
+            } else {
+                method = pdata[5];
+                u_len = get_le32(pdata + 6);
+                c_len = get_le32(pdata + 10);
+                pdata += 14;
+                assert(14 + c_len == (unsigned) plen);
+            }
+            assert((unsigned) plen < u_len);
+            inputlen = u_len;
+            input = New(byte, inputlen + 1);
+            unsigned new_len = u_len;
+            int r = upx_decompress(pdata, c_len, input, &new_len, method, nullptr);
+            if (r == UPX_E_OUT_OF_MEMORY)
+                throwOutOfMemoryException();
+            if (r != UPX_E_OK || new_len != u_len)
+                throwBadLoader();
         } else {
-            method = pdata[5];
-            u_len = get_le32(pdata + 6);
-            c_len = get_le32(pdata + 10);
-            pdata += 14;
-            assert(14 + c_len == (unsigned) plen);
+            inputlen = plen;
+            input = New(byte, inputlen + 1);
+            if (inputlen)
+                memcpy(input, pdata, inputlen);
         }
-        assert((unsigned) plen < u_len);
-        inputlen = u_len;
-        input = New(byte, inputlen + 1);
-        unsigned new_len = u_len;
-        int r = upx_decompress(pdata, c_len, input, &new_len, method, nullptr);
-        if (r == UPX_E_OUT_OF_MEMORY)
-            throwOutOfMemoryException();
-        if (r != UPX_E_OK || new_len != u_len)
-            throwBadLoader();
-    } else {
-        inputlen = plen;
-        input = New(byte, inputlen + 1);
-        if (inputlen)
-            memcpy(input, pdata, inputlen);
+        input[inputlen] = 0; // NUL terminate
+
+        // FIXME: bad compare when either symbols or relocs are absent
+        if ((int) strlen("Sections:\n"
+                         "SYMBOL TABLE:\n"
+                         "RELOCATION RECORDS FOR ") < inputlen) {
+            char const *const eof = (char const *) &input[inputlen];
+            int pos = find(input, inputlen, "Sections:\n", 10);
+            assert(pos != -1);
+            char *const psections = (char *) input + pos;
+
+            char *const psymbols = strstr(psections, "SYMBOL TABLE:\n");
+            // assert(psymbols != nullptr);
+
+            char *const prelocs =
+                strstr((psymbols ? psymbols : psections), "RELOCATION RECORDS FOR ");
+            // assert(prelocs != nullptr);
+
+            preprocessSections(psections, (psymbols ? psymbols : (prelocs ? prelocs : eof)));
+            if (psymbols)
+                preprocessSymbols(psymbols, (prelocs ? prelocs : eof));
+            if (prelocs)
+                preprocessRelocations(prelocs, eof);
+        }
+        addStubImage(pdata_v, plen, adler);
     }
-    input[inputlen] = 0; // NUL terminate
 
     output_capacity = (inputlen ? (inputlen + pxtra) : 0x4000);
     assert(output_capacity <= (1 << 16)); // LE16 l_info.l_size
@@ -161,28 +351,8 @@ void ElfLinker::init(const void *pdata_v, int plen, unsigned pxtra) {
     outputlen = 0;
     NO_printf("\nElfLinker::init %d @%p\n", output_capacity, output);
 
-    // FIXME: bad compare when either symbols or relocs are absent
-    if ((int) strlen("Sections:\n"
-                     "SYMBOL TABLE:\n"
-                     "RELOCATION RECORDS FOR ") < inputlen) {
-        char const *const eof = (char const *) &input[inputlen];
-        int pos = find(input, inputlen, "Sections:\n", 10);
-        assert(pos != -1);
-        char *const psections = (char *) input + pos;
-
-        char *const psymbols = strstr(psections, "SYMBOL TABLE:\n");
-        // assert(psymbols != nullptr);
-
-        char *const prelocs = strstr((psymbols ? psymbols : psections), "RELOCATION RECORDS FOR ");
-        // assert(prelocs != nullptr);
-
-        preprocessSections(psections, (psymbols ? psymbols : (prelocs ? prelocs : eof)));
-        if (psymbols)
-            preprocessSymbols(psymbols, (prelocs ? prelocs : eof));
-        if (prelocs)
-            preprocessRelocations(prelocs, eof);
+    if (nsections > 0)
         addLoader("*UND*");
-    }
 }
 
 void ElfLinker::preprocessSections(char *start, char const *end) {
@@ -298,18 +468,18 @@ void ElfLinker::preprocessRelocations(char *start, char const *end) {
 }
 
 ElfLinker::Section *ElfLinker::findSection(const char *name, bool fatal) const {
-    for (unsigned ic = 0; ic < nsections; ic++)
-        if (strcmp(sections[ic]->name, name) == 0)
-            return sections[ic];
+    Section *section = name_hash_find(section_hash, section_hash_mask, name);
+    if (section != nullptr)
+        return section;
     if (fatal)
         internal_error("unknown section %s\n", name);
     return nullptr;
 }
 
 ElfLinker::Symbol *ElfLinker::findSymbol(const char *name, bool fatal) const {
-    for (unsigned ic = 0; ic < nsymbols; ic++)
-        if (strcmp(symbols[ic]->name, name) == 0)
-            return symbols[ic];
+    Symbol *symbol = name_hash_find(symbol_hash, symbol_hash_mask, name);
+    if (symbol != nullptr)
+        return symbol;
     if (fatal)
         internal_error("unknown symbol %s\n", name);
     return nullptr;
@@ -331,6 +501,7 @@ ElfLinker::Section *ElfLinker::addSection(const char *sname, const void *sdata,
     Section *sec = new Section(sname, sdata, slen, p2align);
     sec->sort_id = nsections;
     sections[nsections++] = sec;
+    name_hash_add(section_hash, section_hash_mask, sections, nsections);
     return sec;
 }
 
@@ -346,6 +517,7 @@ ElfLinker::Symbol *ElfLinker::addSymbol(const char *name, const char *section,
     assert(findSymbol(name, false) == nullptr);
     Symbol *sym = new Symbol(name, findSection(section), offset);
     symbols[nsymbols++] = sym;
+    name_hash_add(symbol_hash, symbol_hash_mask, symbols, nsymbols);
     return sym;
 }
 
@@ -360,6 +532,48 @@ ElfLinker::Relocation *ElfLinker::addRelocation(const char *section, unsigned of
     return rel;
 }
 
+TEST_CASE("ElfLinker name lookup") {
+    static const byte data[8] = {0};
+    ElfLinker linker;
+    char name[16];
+    for (int i = 0; i < 1000; i++) { // grows the hash table several times
+        upx_safe_snprintf(name, sizeof(name), "S%d", i);
+        linker.addSection(name, data, 1 + i % 8, 0);
+    }
+    for (int i = 999; i >= 0; i--) {
+        upx_safe_snprintf(name, sizeof(name), "S%d", i);
+        CHECK(linker.getSectionSize(name) == 1 + i % 8);
+    }
+    CHECK_THROWS(linker.getSectionSize("S1000"));
+    CHECK_THROWS(linker.getSymbolOffset("S0"));
+}
+
+TEST_CASE("ElfLinker stub cache") {
+    static const char stub[] = "\x12\x34"
+                               "Sections:\n"
+                               "Idx Name Size VMA LMA File off Algn\n"
+                               "  0 FOO 00000002 00000000 00000000 00000000 2**0\n"
+                               "SYMBOL TABLE:\n"
+                               "00000001 l       FOO 00000000 bar\n"
+                               "RELOCATION RECORDS FOR [FOO]:\n"
+                               "OFFSET   TYPE              VALUE\n"
+                               "00000000 R_X86_64_8        bar\n";
+    for (int pass = 0; pass < 2; pass++) { // parse, then copy from the cache
+        ElfLinker linker;
+        linker.init(stub, (int) sizeof(stub) - 1);
+        int slen = 0;
+        (void) linker.getSection("FOO", &slen);
+        CHECK(slen == 2);
+        linker.addLoader("FOO");
+        int llen = 0;
+        const byte *loader = linker.getLoader(&llen);
+        CHECK(llen == 2);
+        CHECK(loader[0] == 0x12);
+        CHECK(loader[1] == 0x34);
+        CHECK(linker.getSymbolOffset("bar") == 1);
+    }
+}
+
 #if 0
 void ElfLinker::setLoaderAlignOffset(int phase)
 {
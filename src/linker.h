@@ -40,6 +40,7 @@ protected:
     struct Section;
     struct Symbol;
     struct Relocation;
+    struct StubImage;
 
     byte *input = nullptr;
     int inputlen = 0;
@@ -61,9 +62,20 @@ protected:
     unsigned nrelocations = 0;
     unsigned nrelocations_capacity = 0;
 
+    // open-addressing hash tables for findSection() and findSymbol()
+    Section **section_hash = nullptr;
+    unsigned section_hash_mask = 0;
+    Symbol **symbol_hash = nullptr;
+    unsigned symbol_hash_mask = 0;
+
     bool reloc_done = false;
 
 protected:
+    static StubImage *stub_images; // process-wide cache of parsed stubs; see init()
+    static const StubImage *findStubImage(const void *pdata, int plen, unsigned adler);
+    void addStubImage(const void *pdata, int plen, unsigned adler);
+    void copyStubTables(const ElfLinker *from, const unsigned *rel_symbol);
+
     void preprocessSections(char *start, char const *end);
     void preprocessSymbols(char *start, char const *end);
     void preprocessRelocations(char *start, char const *end);
@@ -186,6 +186,19 @@ static void check_and_update_options(int i, int argc) {
     if (!(opt->cmd == CMD_COMPRESS || opt->cmd == CMD_DECOMPRESS))
         opt->backup = 1;
 
+    if (opt->list_header_only || opt->list_json) {
+        if (!(opt->cmd == CMD_LIST || opt->cmd == CMD_FILEINFO)) {
+            fprintf(stderr, "%s: '%s' needs '-l' or '--fileinfo'\n", argv0,
+                    opt->list_json ? "--json" : "--header-only");
+            e_usage();
+        }
+        if (opt->list_json) {
+            opt->list_header_only = true;
+            if (opt->verbose > 0)
+                opt->verbose = 0; // no headers and totals; errors still go to stderr
+        }
+    }
+
     check_not_both(opt->to_stdout, opt->output_name != nullptr, "--stdout", "-o");
     if (opt->to_stdout && opt->cmd == CMD_COMPRESS) {
         fprintf(stderr, "%s: cannot use '--stdout' when compressing\n", argv0);
@@ -377,6 +390,9 @@ static int do_option(int optc, const char *arg) {
     case 910:
         set_cmd(CMD_SYSINFO);
         break;
+    case 911:
+        set_cmd(CMD_BENCHMARK);
+        break;
     case 'h':
     case 'H':
     case '?':
@@ -460,6 +476,13 @@ static int do_option(int optc, const char *arg) {
     case 724:
         opt->prefer_ucl = true;
         break;
+    case 725:
+        opt->crp.crp_lzma.autotune = true;
+        opt->method_lzma_seen = true;
+        opt->all_methods_use_lzma = 1;
+        if (!set_method(M_LZMA, -1))
+            e_method(M_LZMA, opt->level);
+        break;
 
     // compression level
     case '1':
@@ -542,6 +565,32 @@ static int do_option(int optc, const char *arg) {
     case 531:
         opt->preserve_link = false;
         break;
+    case 532:
+        getoptvar(&opt->threads, 1u, 64u, arg);
+        break;
+    case 535:
+        getoptvar(&opt->max_memory, 64u, 1024u * 1024u, arg);
+        break;
+    case 536:
+        if (!mfx_optarg || !mfx_optarg[0])
+            e_optarg(arg);
+        opt->cache_dir = mfx_optarg;
+        break;
+    case 537:
+        getoptvar(&opt->cache_size, 1u, 1024u * 1024u, arg);
+        break;
+    case 538:
+        getoptvar(&opt->time_budget, 1u, 1000000u, arg);
+        break;
+    case 539:
+        opt->time_budget_hard = true;
+        break;
+    case 533:
+        opt->list_header_only = true;
+        break;
+    case 534:
+        opt->list_json = true;
+        break;
     case 526:
         opt->preserve_mode = false;
         break;
@@ -613,9 +662,15 @@ static int do_option(int optc, const char *arg) {
     case 814:
         getoptvar(&opt->crp.crp_lzma.dict_size, arg);
         break;
+    case 815:
+        getoptvar(&opt->crp.crp_lzma.fast_mode, arg);
+        break;
     case 816:
         getoptvar(&opt->crp.crp_lzma.num_fast_bytes, arg);
         break;
+    case 817:
+        getoptvar(&opt->crp.crp_lzma.match_finder_cycles, arg);
+        break;
     case 821:
         getoptvar(&opt->crp.crp_zlib.mem_level, arg);
         break;
@@ -733,6 +788,11 @@ static int do_option(int optc, const char *arg) {
     case 677:
         opt->o_unix.force_pie = true;
         break;
+    case 678:
+        if (!mfx_optarg || !mfx_optarg[0])
+            e_optarg(arg);
+        opt->o_unix.base = mfx_optarg;
+        break;
     // ps1/exe
     case 670:
         opt->ps1_exe.boot_only = true;
@@ -826,6 +886,9 @@ int main_get_options(int argc, char **argv) {
         {"test", 0, N, 't'},           // test compressed file integrity
         {"uncompress", 0, N, 'd'},     // decompress
         {"version", 0, N, 'V' + 256},  // display version number
+        // time the internal kernels (filters, compressors, checksums, ...)
+        // undocumented and subject to change
+        {"benchmark-internal", 0x90, N, 911},
 
         // options
         {"force", 0, N, 'f'},              // force overwrite of output files
@@ -839,6 +902,14 @@ int main_get_options(int argc, char **argv) {
         {"no-owner", 0x10, N, 527},        // do not preserve ownership
         {"no-progress", 0, N, 516},        // no progress bar
         {"no-time", 0x10, N, 528},         // do not preserve timestamp
+        {"threads", 0x31, N, 532},         // --threads=
+        {"max-memory", 0x31, N, 535},      // --max-memory=
+        {"cache-dir", 0x31, N, 536},       // --cache-dir=
+        {"cache-size", 0x31, N, 537},      // --cache-size=
+        {"time-budget", 0x31, N, 538},     // --time-budget=
+        {"time-budget-hard", 0x10, N, 539},
+        {"header-only", 0x10, N, 533},     // -l, --fileinfo: only decode the PackHeader
+        {"json", 0x10, N, 534},            // -l, --fileinfo: JSON output
         {"output", 0x21, N, 'o'},
         {"quiet", 0, N, 'q'},  // quiet mode
         {"silent", 0, N, 'q'}, // quiet mode
@@ -886,6 +957,7 @@ int main_get_options(int argc, char **argv) {
         {"nrv2d", 0x10, N, 704},   // --nrv2d
         {"nrv2e", 0x10, N, 705},   // --nrv2e
         {"lzma", 0x10, N, 721},    // --lzma
+        {"lzma-autotune", 0x10, N, 725},
         {"no-lzma", 0x10, N, 722}, // disable all_methods_use_lzma
         {"prefer-nrv", 0x10, N, 723},
         {"prefer-ucl", 0x10, N, 724},
@@ -915,7 +987,9 @@ int main_get_options(int argc, char **argv) {
         {"crp-lzma-lp", 0x31, N, 812},
         {"crp-lzma-lc", 0x31, N, 813},
         {"crp-lzma-ds", 0x31, N, 814},
+        {"crp-lzma-fm", 0x31, N, 815},
         {"crp-lzma-fb", 0x31, N, 816},
+        {"crp-lzma-mfc", 0x31, N, 817},
         {"crp-zlib-ml", 0x31, N, 821},
         {"crp-zlib-wb", 0x31, N, 822},
         {"crp-zlib-st", 0x31, N, 823},
@@ -947,6 +1021,7 @@ int main_get_options(int argc, char **argv) {
         {"preserve-build-id", 0, N, 675},
         {"android-shlib", 0, N, 676},
         {"force-pie", 0x90, N, 677},
+        {"base", 0x31, N, 678}, // --base=
         // ps1/exe
         {"boot-only", 0x90, N, 670},
         {"no-align", 0x90, N, 671},
@@ -1057,13 +1132,16 @@ void main_get_envoptions() {
         {"color", 0x10, N, 514},
 
         // compression settings
-        {"exact", 0x10, N, 525}, // user requires byte-identical decompression
+        {"exact", 0x10, N, 525},      // user requires byte-identical decompression
+        {"threads", 0x31, N, 532},    // --threads=
+        {"max-memory", 0x31, N, 535}, // --max-memory=
 
         // compression method
         {"nrv2b", 0x10, N, 702},   // --nrv2b
         {"nrv2d", 0x10, N, 704},   // --nrv2d
         {"nrv2e", 0x10, N, 705},   // --nrv2e
         {"lzma", 0x10, N, 721},    // --lzma
+        {"lzma-autotune", 0x10, N, 725},
         {"no-lzma", 0x10, N, 722}, // disable all_methods_use_lzma
         {"prefer-nrv", 0x10, N, 723},
         {"prefer-ucl", 0x10, N, 724},
@@ -1268,6 +1346,10 @@ int upx_main(int argc, char *argv[]) may_throw {
         show_sysinfo(OPTIONS_VAR);
         e_exit(EXIT_OK);
         break;
+    case CMD_BENCHMARK:
+        upx_benchmark_internal();
+        e_exit(EXIT_OK);
+        break;
     case CMD_HELP:
         show_help(1);
         e_exit(EXIT_OK);
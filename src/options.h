@@ -48,6 +48,7 @@ enum {
     CMD_LIST,
     CMD_FILEINFO,
     CMD_SYSINFO,
+    CMD_BENCHMARK,
     CMD_HELP,
     CMD_LICENSE,
     CMD_VERSION,
@@ -73,6 +74,8 @@ struct Options final {
     bool no_filter;   // force no filter
     bool prefer_ucl;  // prefer UCL
     bool exact;       // user requires byte-identical decompression
+    int hint_method;  // try first in compressWithFilters(); 0 means no hint
+    int hint_filter;  // try first in compressWithFilters(), together with hint_method
 
     // other options
     int backup;
@@ -89,9 +92,19 @@ struct Options final {
     bool preserve_ownership;
     bool preserve_timestamp;
     int small;
+    unsigned threads;      // number of worker threads; 0 means one per CPU
+    unsigned max_memory;   // sizing hint in MiB, not a limit; 0 means none
+    const char *cache_dir; // see class PackCache
+    unsigned cache_size;   // cache size limit in MiB; 0 means the default
+    unsigned time_budget;  // packing time limit per file in seconds; 0 means no limit
+    bool time_budget_hard; // fail instead of keeping the best result so far
     int verbose;
     bool to_stdout;
 
+    // -l and --fileinfo
+    bool list_header_only; // only decode the PackHeader; see PackMaster::findPackHeader()
+    bool list_json;        // print one JSON object per file
+
     // overlay handling
     enum { SKIP_OVERLAY = 0, COPY_OVERLAY = 1, STRIP_OVERLAY = 2 };
     int overlay;
@@ -159,6 +172,7 @@ struct Options final {
         bool preserve_build_id; // copy the build-id to the compressed binary
         bool android_shlib;     // keep some ElfXX_Shdr for dlopen()
         bool force_pie;         // choose DF_1_PIE instead of is_shlib
+        const char *base;       // older packed file whose blocks may be reused
     } o_unix;
     struct {
         bool boot_only;
@@ -66,9 +66,10 @@ const int *PackDjgpp2::getFilters() const {
     return filters;
 }
 
-unsigned PackDjgpp2::findOverlapOverhead(const byte *buf, const byte *tbuf, unsigned range,
+unsigned PackDjgpp2::findOverlapOverhead(const PackHeader &oph, const byte *buf,
+                                         const byte *tbuf, unsigned range,
                                          unsigned upper_limit) const {
-    unsigned o = super::findOverlapOverhead(buf, tbuf, range, upper_limit);
+    unsigned o = super::findOverlapOverhead(oph, buf, tbuf, range, upper_limit);
     o = (o + 0x3ff) & ~0x1ff;
     return o;
 }
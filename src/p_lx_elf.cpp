@@ -144,6 +144,14 @@ funpad4(InputFile *fi)
 static void alloc_file_image(MemBuffer &mb, off_t size)
 {
     assert(mem_size_valid_bytes(size));
+    // --max-memory only applies when packing; -d/-t/-l of a file packed
+    // elsewhere must not fail because of it (it may come from $UPX, too)
+    upx_uint64_t const max_memory = upx_get_max_memory();
+    if (opt->cmd == CMD_COMPRESS && max_memory && (upx_uint64_t)size > max_memory / 2) {
+        char msg[80]; snprintf(msg, sizeof(msg),
+            "ET_DYN file image of %#llx bytes exceeds --max-memory", (unsigned long long)size);
+        throwCantPack(msg);
+    }
     if (mb.getVoidPtr() == nullptr) {
         mb.alloc(size);
     } else {
@@ -2983,6 +2991,7 @@ proceed: ;
     // this->blocksize: avoid over-allocating.
     // (file_size - max_offset): debug info, non-globl symbols, etc.
     opt->o_unix.blocksize = blocksize = UPX_MAX(max_LOADsz, (unsigned)(file_size - max_offset));
+    opt->o_unix.blocksize = blocksize = capBlocksize(blocksize);  // --max-memory
     return true;
 }
 
@@ -3409,6 +3418,7 @@ proceed: ;
     // this->blocksize: avoid over-allocating.
     // (file_size - max_offset): debug info, non-globl symbols, etc.
     opt->o_unix.blocksize = blocksize = UPX_MAX(max_LOADsz, file_size - max_offset);
+    opt->o_unix.blocksize = blocksize = capBlocksize(blocksize);  // --max-memory
     return true;
 }
 
@@ -3918,6 +3928,8 @@ void PackLinuxElf32::pack1(OutputFile * /*fo*/, Filter &ft)
         unsigned sz_best= ~0u;
         int method_best = 0;
         for (unsigned k = 0; k < nmethods; ++k) { // FIXME: parallelize; cost: working space
+            if (method_best != 0 && upx_time_budget_expired())
+                break;  // --time-budget: keep the best method so far
             unsigned sz_this = 0;
             Elf32_Phdr *phdr = phdri;
             for (unsigned j=0; j < e_phnum; ++phdr, ++j) {
@@ -4808,6 +4820,8 @@ void PackLinuxElf64::pack1(OutputFile * /*fo*/, Filter &ft)
         unsigned sz_best= ~0u;
         int method_best = 0;
         for (unsigned k = 0; k < nmethods; ++k) { // FIXME: parallelize; cost: working space
+            if (method_best != 0 && upx_time_budget_expired())
+                break;  // --time-budget: keep the best method so far
             unsigned sz_this = 0;
             Elf64_Phdr *phdr = phdri;
             for (unsigned j=0; j < e_phnum; ++phdr, ++j) {
@@ -7310,8 +7324,13 @@ void PackLinuxElf64::unpack(OutputFile *fo)
         phdr = (Elf64_Phdr *) (void *) (1+ ehdr);  // uncompressed
         for (unsigned j=0; j < u_phnum; ++phdr, ++j) {
             if (PT_LOAD64==get_te32(&phdr->p_type)) {
-                unsigned const filesz = get_te64(&phdr->p_filesz);
-                unsigned const offset = get_te64(&phdr->p_offset);
+                upx_uint64_t const filesz64 = get_te64(&phdr->p_filesz);
+                upx_uint64_t const offset64 = get_te64(&phdr->p_offset);
+                if (filesz64 > UPX_RSIZE_MAX || offset64 > UPX_RSIZE_MAX) // no silent truncation
+                    throwCantUnpack("bad PT_LOAD %#llx %#llx",
+                        (unsigned long long) offset64, (unsigned long long) filesz64);
+                unsigned const filesz = (unsigned) filesz64;
+                unsigned const offset = (unsigned) offset64;
                 if (fo)
                     fo->seek(offset, SEEK_SET);
                 if (Elf64_Phdr::PF_X & get_te32(&phdr->p_flags)) {
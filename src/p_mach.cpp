@@ -2314,12 +2314,68 @@ const int *PackMachFat::getFilters() const
     return filters;  // sham
 }
 
+// Return a new packer for the slice that f is currently set to,
+// or nullptr if the slice is neither MH_EXECUTE nor MH_DYLIB.
+PackUnix *PackMachFat::newSlicePacker(InputFile *f, unsigned cputype)
+{
+    f->seek(0, SEEK_SET);
+    switch (cputype) {
+    case PackMachFat::CPU_TYPE_I386: {
+        typedef N_Mach::Mach_header<MachClass_LE32::MachITypes> Mach_header;
+        Mach_header hdr;
+        f->readx(&hdr, sizeof(hdr));
+        if (hdr.filetype==Mach_header::MH_EXECUTE)
+            return new PackMachI386(f);
+        if (hdr.filetype==Mach_header::MH_DYLIB)
+            return new PackDylibI386(f);
+    } break;
+    case PackMachFat::CPU_TYPE_X86_64: {
+        typedef N_Mach::Mach_header<MachClass_LE64::MachITypes> Mach_header;
+        Mach_header hdr;
+        f->readx(&hdr, sizeof(hdr));
+        if (hdr.filetype==Mach_header::MH_EXECUTE)
+            return new PackMachAMD64(f);
+        if (hdr.filetype==Mach_header::MH_DYLIB)
+            return new PackDylibAMD64(f);
+    } break;
+    case PackMachFat::CPU_TYPE_ARM64: {
+        typedef N_Mach::Mach_header<MachClass_LE64::MachITypes> Mach_header;
+        Mach_header hdr;
+        f->readx(&hdr, sizeof(hdr));
+        if (hdr.filetype==Mach_header::MH_EXECUTE)
+            return new PackMachARM64EL(f);
+        // no PackDylibARM64EL yet; see canPack()
+    } break;
+    case PackMachFat::CPU_TYPE_POWERPC: {
+        typedef N_Mach::Mach_header<MachClass_BE32::MachITypes> Mach_header;
+        Mach_header hdr;
+        f->readx(&hdr, sizeof(hdr));
+        if (hdr.filetype==Mach_header::MH_EXECUTE)
+            return new PackMachPPC32(f);
+        if (hdr.filetype==Mach_header::MH_DYLIB)
+            return new PackDylibPPC32(f);
+    } break;
+    case PackMachFat::CPU_TYPE_POWERPC64: {
+        typedef N_Mach::Mach_header<MachClass_LE64::MachITypes> Mach_header;
+        Mach_header hdr;
+        f->readx(&hdr, sizeof(hdr));
+        if (hdr.filetype==Mach_header::MH_EXECUTE)
+            return new PackMachPPC64(f);
+        if (hdr.filetype==Mach_header::MH_DYLIB)
+            return new PackDylibPPC64(f);
+    } break;
+    }  // switch cputype
+    return nullptr;
+}
+
 void PackMachFat::pack(OutputFile *fo)
 {
     unsigned const in_size = this->file_size;
     fo->write(&fat_head, sizeof(fat_head.fat) +
         fat_head.fat.nfat_arch * sizeof(fat_head.arch[0]));
     unsigned length = 0;
+    if (!(fat_head.fat.nfat_arch > 1 && upx_get_num_threads() > 1 &&
+          packSlicesParallel(fo, length)))
     for (unsigned j=0; j < fat_head.fat.nfat_arch; ++j) {
         unsigned base = fo->unset_extent();  // actual length
         base += ~(~0u<<fat_head.arch[j].align) & (0-base);  // align up
@@ -2328,85 +2384,13 @@ void PackMachFat::pack(OutputFile *fo)
 
         ph.u_file_size = fat_head.arch[j].size;
         fi->set_extent(fat_head.arch[j].offset, fat_head.arch[j].size);
-        fi->seek(0, SEEK_SET);
-        switch (fat_head.arch[j].cputype) {
-        case PackMachFat::CPU_TYPE_I386: {
-            typedef N_Mach::Mach_header<MachClass_LE32::MachITypes> Mach_header;
-            Mach_header hdr;
-            fi->readx(&hdr, sizeof(hdr));
-            if (hdr.filetype==Mach_header::MH_EXECUTE) {
-                PackMachI386 packer(fi);
-                packer.initPackHeader();
-                packer.canPack();
-                packer.updatePackHeader();
-                packer.pack(fo);
-            }
-            else if (hdr.filetype==Mach_header::MH_DYLIB) {
-                PackDylibI386 packer(fi);
-                packer.initPackHeader();
-                packer.canPack();
-                packer.updatePackHeader();
-                packer.pack(fo);
-            }
-        } break;
-        case PackMachFat::CPU_TYPE_X86_64: {
-            typedef N_Mach::Mach_header<MachClass_LE64::MachITypes> Mach_header;
-            Mach_header hdr;
-            fi->readx(&hdr, sizeof(hdr));
-            if (hdr.filetype==Mach_header::MH_EXECUTE) {
-                PackMachAMD64 packer(fi);
-                packer.initPackHeader();
-                packer.canPack();
-                packer.updatePackHeader();
-                packer.pack(fo);
-            }
-            else if (hdr.filetype==Mach_header::MH_DYLIB) {
-                PackDylibAMD64 packer(fi);
-                packer.initPackHeader();
-                packer.canPack();
-                packer.updatePackHeader();
-                packer.pack(fo);
-            }
-        } break;
-        case PackMachFat::CPU_TYPE_POWERPC: {
-            typedef N_Mach::Mach_header<MachClass_BE32::MachITypes> Mach_header;
-            Mach_header hdr;
-            fi->readx(&hdr, sizeof(hdr));
-            if (hdr.filetype==Mach_header::MH_EXECUTE) {
-                PackMachPPC32 packer(fi);
-                packer.initPackHeader();
-                packer.canPack();
-                packer.updatePackHeader();
-                packer.pack(fo);
-            }
-            else if (hdr.filetype==Mach_header::MH_DYLIB) {
-                PackDylibPPC32 packer(fi);
-                packer.initPackHeader();
-                packer.canPack();
-                packer.updatePackHeader();
-                packer.pack(fo);
-            }
-        } break;
-        case PackMachFat::CPU_TYPE_POWERPC64: {
-            typedef N_Mach::Mach_header<MachClass_LE64::MachITypes> Mach_header;
-            Mach_header hdr;
-            fi->readx(&hdr, sizeof(hdr));
-            if (hdr.filetype==Mach_header::MH_EXECUTE) {
-                PackMachPPC64 packer(fi);
-                packer.initPackHeader();
-                packer.canPack();
-                packer.updatePackHeader();
-                packer.pack(fo);
-            }
-            else if (hdr.filetype==Mach_header::MH_DYLIB) {
-                PackDylibPPC64 packer(fi);
-                packer.initPackHeader();
-                packer.canPack();
-                packer.updatePackHeader();
-                packer.pack(fo);
-            }
-        } break;
-        }  // switch cputype
+        std::unique_ptr<PackUnix> packer(newSlicePacker(fi, fat_head.arch[j].cputype));
+        if (packer) {
+            packer->initPackHeader();
+            packer->canPack();
+            packer->updatePackHeader();
+            packer->pack(fo);
+        }
         fat_head.arch[j].offset = base;
         length = fo->unset_extent();
         fat_head.arch[j].size = length - base;
@@ -2420,6 +2404,103 @@ void PackMachFat::pack(OutputFile *fo)
     fo->set_extent(0, length);
 }
 
+// The slices of a fat file are independent, so pack them concurrently:
+// each slice is read through its own InputFile and packed into its own
+// temporary file next to the output, which then is appended to fo in the
+// original order. The output is identical to the serial loop in pack().
+// Returns false if the temporary files cannot be created; nothing has
+// been written to fo then, and the caller packs the slices serially.
+bool PackMachFat::packSlicesParallel(OutputFile *fo, unsigned &length)
+{
+    struct Slice {
+        InputFile fi;
+        OutputFile fo;
+        std::unique_ptr<PackUnix> packer;
+        char tname[ACC_FN_PATH_MAX + 1] = {};
+        ~Slice() noexcept {
+            packer.reset();
+            fo.close_noexcept();
+            if (tname[0])
+                (void) FileBase::unlink_noexcept(tname);
+        }
+    };
+    // restore opt->verbose, which is lowered while creating the slice packers
+    struct VerboseGuard {
+        int const saved = opt->verbose;
+        ~VerboseGuard() noexcept { opt->verbose = saved; }
+    };
+    if (opt->to_stdout)
+        return false;
+    unsigned const nfat = fat_head.fat.nfat_arch;
+    Slice slices[N_FAT_ARCH];  // destroyed in reverse order, as required by PackUnix
+    for (unsigned j=0; j < nfat; ++j) {
+        // the directory of the output is writable, unlike maybe that of the input
+        Slice &s = slices[j];
+        if (!maketempname(s.tname, sizeof(s.tname), fo->getName(), ".upf", true))
+            return false;
+        try {
+            s.fo.open(s.tname, O_WRONLY | O_BINARY | O_CREAT | O_EXCL, 0600);
+        } catch (const IOException &) {
+            s.tname[0] = 0;  // not ours
+            return false;
+        }
+    }
+    unsigned max_size = 0;
+    for (unsigned j=0; j < nfat; ++j) {
+        Slice &s = slices[j];
+        s.fi.open(fi->getName(), O_RDONLY | O_BINARY);
+        s.fi.set_extent(fat_head.arch[j].offset, fat_head.arch[j].size);
+        {
+            // concurrent progress bars would garble the terminal,
+            // so the UiPacker of a slice only prints the final info
+            VerboseGuard guard;
+            opt->verbose = UPX_MIN(guard.saved, 0);
+            s.packer.reset(newSlicePacker(&s.fi, fat_head.arch[j].cputype));
+        }
+        if (!s.packer)
+            continue;
+        s.packer->initPackHeader();
+        s.packer->canPack();
+        s.packer->updatePackHeader();
+        max_size = UPX_MAX(max_size, (unsigned) fat_head.arch[j].size);
+    }
+    // each canPack() has set the blocksize to the size of its own slice;
+    // PackUnix::pack() clamps it to the file_size of the slice again
+    opt->o_unix.blocksize = max_size;
+
+    // each slice packer gets its share of --threads and of the memory
+    // for the parallel trials; see upx_parallel_for()
+    upx_parallel_for(nfat, [&](size_t j) {
+        if (slices[j].packer)
+            slices[j].packer->pack(&slices[j].fo);
+    });
+
+    MemBuffer buf(1024 * 1024);
+    for (unsigned j=0; j < nfat; ++j) {
+        Slice &s = slices[j];
+        unsigned base = fo->unset_extent();  // actual length
+        base += ~(~0u<<fat_head.arch[j].align) & (0-base);  // align up
+        fo->seek(base, SEEK_SET);
+        fo->set_extent(base, ~0u);
+        if (s.packer) {
+            unsigned remaining = (unsigned) s.fo.unset_extent();
+            s.fo.closex();
+            InputFile tf;
+            tf.open(s.tname, O_RDONLY | O_BINARY);
+            while (remaining > 0) {
+                unsigned const len = UPX_MIN(remaining, buf.getSize());
+                tf.readx(buf, len);
+                fo->write(buf, len);
+                remaining -= len;
+            }
+        }
+        fat_head.arch[j].offset = base;
+        length = fo->unset_extent();
+        fat_head.arch[j].size = length - base;
+    }
+    return true;
+}
+
 void PackMachFat::unpack(OutputFile *fo)
 {
     if (fo) {  // test mode ("-t") sets fo = nullptr
@@ -2439,77 +2520,12 @@ void PackMachFat::unpack(OutputFile *fo)
 
         ph.u_file_size = fat_head.arch[j].size;
         fi->set_extent(fat_head.arch[j].offset, fat_head.arch[j].size);
-        fi->seek(0, SEEK_SET);
-        switch (fat_head.arch[j].cputype) {
-        case PackMachFat::CPU_TYPE_I386: {
-            N_Mach::Mach_header<MachClass_LE32::MachITypes> hdr;
-            typedef N_Mach::Mach_header<MachClass_LE32::MachITypes> Mach_header;
-            fi->readx(&hdr, sizeof(hdr));
-            if (hdr.filetype==Mach_header::MH_EXECUTE) {
-                PackMachI386 packer(fi);
-                packer.initPackHeader();
-                packer.canUnpack();
-                packer.unpack(fo);
-            }
-            else if (hdr.filetype==Mach_header::MH_DYLIB) {
-                PackDylibI386 packer(fi);
-                packer.initPackHeader();
-                packer.canUnpack();
-                packer.unpack(fo);
-            }
-        } break;
-        case PackMachFat::CPU_TYPE_X86_64: {
-            N_Mach::Mach_header<MachClass_LE64::MachITypes> hdr;
-            typedef N_Mach::Mach_header<MachClass_LE64::MachITypes> Mach_header;
-            fi->readx(&hdr, sizeof(hdr));
-            if (hdr.filetype==Mach_header::MH_EXECUTE) {
-                PackMachAMD64 packer(fi);
-                packer.initPackHeader();
-                packer.canUnpack();
-                packer.unpack(fo);
-            }
-            else if (hdr.filetype==Mach_header::MH_DYLIB) {
-                PackDylibAMD64 packer(fi);
-                packer.initPackHeader();
-                packer.canUnpack();
-                packer.unpack(fo);
-            }
-        } break;
-        case PackMachFat::CPU_TYPE_POWERPC: {
-            N_Mach::Mach_header<MachClass_BE32::MachITypes> hdr;
-            typedef N_Mach::Mach_header<MachClass_BE32::MachITypes> Mach_header;
-            fi->readx(&hdr, sizeof(hdr));
-            if (hdr.filetype==Mach_header::MH_EXECUTE) {
-                PackMachPPC32 packer(fi);
-                packer.initPackHeader();
-                packer.canUnpack();
-                packer.unpack(fo);
-            }
-            else if (hdr.filetype==Mach_header::MH_DYLIB) {
-                PackDylibPPC32 packer(fi);
-                packer.initPackHeader();
-                packer.canUnpack();
-                packer.unpack(fo);
-            }
-        } break;
-        case PackMachFat::CPU_TYPE_POWERPC64: {
-            N_Mach::Mach_header<MachClass_LE64::MachITypes> hdr;
-            typedef N_Mach::Mach_header<MachClass_LE64::MachITypes> Mach_header;
-            fi->readx(&hdr, sizeof(hdr));
-            if (hdr.filetype==Mach_header::MH_EXECUTE) {
-                PackMachPPC64 packer(fi);
-                packer.initPackHeader();
-                packer.canUnpack();
-                packer.unpack(fo);
-            }
-            else if (hdr.filetype==Mach_header::MH_DYLIB) {
-                PackDylibPPC64 packer(fi);
-                packer.initPackHeader();
-                packer.canUnpack();
-                packer.unpack(fo);
-            }
-        } break;
-        }  // switch cputype
+        std::unique_ptr<PackUnix> packer(newSlicePacker(fi, fat_head.arch[j].cputype));
+        if (packer) {
+            packer->initPackHeader();
+            packer->canUnpack();
+            packer->unpack(fo);
+        }
         fat_head.arch[j].offset = base;
         length = (fo ? fo->unset_extent() : 0);
         fat_head.arch[j].size = length - base;
@@ -2628,6 +2644,12 @@ tribool PackMachFat::canUnpack()
             else
                 ph.format = packer.getFormat(); // FIXME: copy entire PackHeader
         } break;
+        case PackMachFat::CPU_TYPE_ARM64: {
+            PackMachARM64EL packer(fi);
+            if (!packer.canUnpack())
+                return 0;
+            ph.format = packer.getFormat(); // FIXME: copy entire PackHeader
+        } break;
         case PackMachFat::CPU_TYPE_POWERPC: {
             PackMachPPC32 packer(fi);
             if (!packer.canUnpack()) {
@@ -1253,6 +1253,8 @@ public:
 protected:
     // implementation
     virtual unsigned check_fat_head();  // number of architectures
+    static PackUnix *newSlicePacker(InputFile *f, unsigned cputype);
+    bool packSlicesParallel(OutputFile *fo, unsigned &length);
     virtual void pack(OutputFile *fo) override;
     virtual void unpack(OutputFile *fo) override;
     virtual void list() override;
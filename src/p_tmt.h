@@ -54,7 +54,8 @@ public:
 protected:
     int readFileHeader();
 
-    virtual unsigned findOverlapOverhead(const byte *buf, const byte *tbuf, unsigned range = 0,
+    virtual unsigned findOverlapOverhead(const PackHeader &oph, const byte *buf, const byte *tbuf,
+                                         unsigned range = 0,
                                          unsigned upper_limit = ~0u) const override;
     virtual void buildLoader(const Filter *ft) override;
     virtual Linker *newLinker() const override;
@@ -47,8 +47,8 @@
 **************************************************************************/
 
 PackUnix::PackUnix(InputFile *f) :
-    super(f), exetype(0), blocksize(0), overlay_offset(0), lsize(0),
-    methods_used(0), szb_info(sizeof(b_info))
+    super(f), base_fi(nullptr), base_nblocks(0), base_hash_mask(0), base_loaded(false),
+    exetype(0), blocksize(0), overlay_offset(0), lsize(0), methods_used(0), szb_info(sizeof(b_info))
 {
     COMPILE_TIME_ASSERT(sizeof(Elf32_Ehdr) == 52)
     COMPILE_TIME_ASSERT(sizeof(Elf32_Phdr) == 32)
@@ -64,6 +64,10 @@ PackUnix::PackUnix(InputFile *f) :
 PackUnix::~PackUnix()
 {
     opt->o_unix.android_shlib = saved_opt_android_shlib;
+    if (base_fi != nullptr) {
+        (void) base_fi->close_noexcept(); // IGNORE_ERROR; read-only
+        delete (InputFile *) base_fi;
+    }
 }
 
 // common part of canPack(), enhanced by subclasses
@@ -191,7 +195,7 @@ int PackUnix::pack2(OutputFile *fo, Filter &ft)
             const upx_bytep tbuf = nullptr;
             if (ft.id == 0) tbuf = ibuf;
             ph.overlap_overhead = OVERHEAD;
-            if (!testOverlappingDecompression(obuf, tbuf, ph.overlap_overhead)) {
+            if (!testOverlappingDecompression(ph, obuf, tbuf, ph.overlap_overhead)) {
                 // not in-place compressible
                 ph.c_len = ph.u_len;
             }
@@ -339,6 +343,8 @@ void PackUnix::packExtent(
 {
     unsigned const init_u_adler = ph.u_adler;
     unsigned const init_c_adler = ph.c_adler;
+    if (!base_loaded)
+        loadBase();
     MemBuffer hdr_ibuf;
     if (hdr_u_len) {
         hdr_ibuf.alloc(hdr_u_len);
@@ -375,10 +381,12 @@ void PackUnix::packExtent(
             ft->id = 0;
             ft->cto = 0;
 
-            compressWithFilters(ft, OVERHEAD, NULL_cconf, filter_strategy,
-                                0, 0, 0, hdr_ibuf, hdr_u_len, inhibit_compression_check);
+            if (hdr_u_len || !reuseBaseBlock(l, ft, filter_strategy, b_extra)) {
+                compressWithFilters(ft, OVERHEAD, NULL_cconf, filter_strategy,
+                                    0, 0, 0, hdr_ibuf, hdr_u_len, inhibit_compression_check);
+            }
         }
-        else {
+        else if (hdr_u_len || !reuseBaseBlock(l, nullptr, 0, b_extra)) {
             (void) compress(ibuf, ph.u_len, obuf);    // ignore return value
         }
 
@@ -386,7 +394,7 @@ void PackUnix::packExtent(
             const upx_bytep tbuf = nullptr;
             if (ft == nullptr || ft->id == 0) tbuf = ibuf;
             ph.overlap_overhead = OVERHEAD;
-            if (!testOverlappingDecompression(obuf, tbuf, ph.overlap_overhead)) {
+            if (!testOverlappingDecompression(ph, obuf, tbuf, ph.overlap_overhead)) {
                 // not in-place compressible
                 ph.c_len = ph.u_len;
             }
@@ -463,6 +471,252 @@ void PackUnix::packExtent(
     }
 }
 
+// --base=FILE: read the b_info chain of an older packed version of the
+// same program, and remember the checksum of each uncompressed block.
+// Only the BaseBlock table stays in memory; reuseBaseBlock() reads the
+// compressed data of a candidate from base_fi->
+void PackUnix::loadBase()
+{
+    base_loaded = true;
+    const char *const bname = opt->o_unix.base;
+    if (bname == nullptr || szb_info != sizeof(b_info))
+        return;
+    base_fi = new InputFile();
+    base_fi->open(bname, O_RDONLY | O_BINARY);
+    off_t const bsize = base_fi->st_size();
+    if (bsize <= 0 || bsize >= 0x7fffffff)
+        throwCantPack("--base: bad file size");
+
+    // find the PackHeader and the overlay_offset, as in find_overlay_offset()
+    MemBuffer tail(UPX_MIN(bsize, (off_t) 65536));
+    unsigned const tail_pos = (unsigned) bsize - tail.getSize();
+    base_fi->seek(tail_pos, SEEK_SET);
+    base_fi->readx(tail, tail.getSize());
+    const byte *const tbuf = raw_bytes(tail, tail.getSize());
+    int const small = 32 + sizeof(overlay_offset);
+    int i = (int) tail.getSize();
+    while (i > small && 0 == tbuf[--i]) { }
+    i -= small;
+    PackHeader bph;
+    unsigned boff = 0;
+    try {
+        if (i < 0 || !bph.decodePackHeaderFromBuf(SPAN_S_MAKE(const byte, tbuf + i,
+                                                              tail.getSize() - i),
+                                                  (int) tail.getSize() - i))
+            throwCantPack("--base: not packed by UPX");
+        int l = bph.buf_offset + bph.getPackHeaderSize();
+        if (l < 0 || i + l + 4 > (int) tail.getSize())
+            throwCantPack("--base: file corrupted");
+        boff = get_te32(tbuf + i + l);
+    } catch (const CantUnpackException &) {
+        throwCantPack("--base: file corrupted");
+    }
+    if (bph.format != ph.format || bph.version != ph.version)
+        throwCantPack("--base: different executable format");
+    if (bph.level != ph.level) {
+        // reused blocks would keep the compression of the other level
+        infoWarning("--base: packed with -%d instead of -%d; not used", bph.level, ph.level);
+        base_fi->closex();
+        return;
+    }
+    unsigned const end = tail_pos + i;  // start of the PackHeader
+    if (boff + sizeof(p_info) + sizeof(b_info) > end)
+        throwCantPack("--base: file corrupted");
+    byte pi[sizeof(p_info)];
+    base_fi->seek(boff, SEEK_SET);
+    base_fi->readx(pi, sizeof(pi));
+    unsigned const bblocksize = get_te32(pi + 8); // p_info.p_blocksize
+    if (bblocksize == 0 || bblocksize > (unsigned) bsize * 273) // zlib limit
+        throwCantPack("--base: file corrupted");
+
+    // Walk the b_info chain. Extents may be separated by padding, by the
+    // loader or by data which is not compressed; after such a gap, search
+    // byte by byte for the next block which decompresses. A stored block
+    // is only accepted right after another block, as its b_info proves
+    // little by itself.
+    MemBuffer win(65536);  // the b_info headers, read ahead
+    unsigned win_pos = 0, win_len = 0;
+    MemBuffer cbuf(bblocksize);
+    MemBuffer ubuf(bblocksize);
+    unsigned pos = boff + sizeof(p_info);
+    bool chained = true;
+    while (pos + sizeof(b_info) <= end) {
+        if (pos < win_pos || pos + sizeof(b_info) > win_pos + win_len) {
+            win_pos = pos;
+            win_len = UPX_MIN(win.getSize(), end - pos);
+            base_fi->seek(win_pos, SEEK_SET);
+            base_fi->readx(win, win_len);
+        }
+        const byte *const p = raw_bytes(win, win_len) + (pos - win_pos);
+        BaseBlock b;
+        b.offset = pos + sizeof(b_info);
+        b.sz_unc = get_te32(p + 0);
+        b.sz_cpr = get_te32(p + 4);
+        b.b_method = p[8];
+        b.b_ftid = p[9];
+        b.b_cto8 = p[10];
+        b.b_extra = p[11];
+        bool const stored = (b.sz_cpr == b.sz_unc);
+        bool ok = b.sz_unc != 0 && b.sz_cpr != 0 && b.sz_cpr <= b.sz_unc &&
+                  b.sz_unc <= bblocksize && b.sz_cpr <= end - b.offset;
+        if (ok && stored)
+            ok = chained && b.b_method == 0 && b.b_ftid == 0 && b.b_cto8 == 0;
+        else if (ok)
+            ok = isValidCompressionMethod(b.b_method) &&
+                 (b.b_ftid == 0 || Filter::isValidFilter(b.b_ftid));
+        if (ok) {
+            // checksum the uncompressed and unfiltered data
+            base_fi->seek(b.offset, SEEK_SET);
+            base_fi->readx(cbuf, b.sz_cpr);
+            if (stored) {
+                b.crc = upx_crc32(cbuf, b.sz_unc);
+            } else {
+                unsigned new_len = b.sz_unc;
+                int r = upx_decompress(cbuf, b.sz_cpr, ubuf, &new_len, b.b_method, nullptr);
+                ok = (r == UPX_E_OK && new_len == b.sz_unc);
+                if (ok && b.b_ftid) {
+                    Filter ft(ph.level);
+                    ft.init(b.b_ftid, 0);
+                    ft.cto = b.b_cto8;
+                    ft.unfilter(ubuf, b.sz_unc);
+                }
+                if (ok)
+                    b.crc = upx_crc32(ubuf, b.sz_unc);
+            }
+        }
+        if (!ok) {
+            pos += 1;
+            chained = false;
+            continue;
+        }
+        addBaseBlock(b);
+        pos = b.offset + b.sz_cpr;
+        chained = true;
+    }
+    if (base_nblocks == 0) {
+        base_fi->closex();
+        return;
+    }
+
+    // index by (crc, sz_unc), at most half full
+    unsigned hsize = 16;
+    while (hsize < 2 * base_nblocks)
+        hsize *= 2;
+    base_hash.alloc(mem_size(sizeof(unsigned), hsize));
+    base_hash.clear();
+    base_hash_mask = hsize - 1;
+    unsigned *const htab = (unsigned *) base_hash.getVoidPtr();
+    const BaseBlock *const bb = (const BaseBlock *) base_blocks.getVoidPtr();
+    for (unsigned k = 0; k < base_nblocks; k++) {
+        unsigned h = (bb[k].crc ^ (bb[k].sz_unc * 0x9e3779b1u)) & base_hash_mask;
+        while (htab[h] != 0)
+            h = (h + 1) & base_hash_mask;
+        htab[h] = k + 1;
+    }
+}
+
+void PackUnix::addBaseBlock(const BaseBlock &b)
+{
+    // grow base_blocks by doubling; MemBuffer cannot realloc
+    unsigned const cap = base_blocks.getSize() / sizeof(BaseBlock);
+    if (base_nblocks == cap) {
+        MemBuffer tmp(mem_size(sizeof(BaseBlock), cap ? 2 * cap : 64));
+        if (base_nblocks)
+            memcpy(tmp, base_blocks, mem_size(sizeof(BaseBlock), base_nblocks));
+        base_blocks.dealloc();
+        base_blocks.alloc(tmp.getSize());
+        memcpy(base_blocks, tmp, tmp.getSize());
+    }
+    ((BaseBlock *) base_blocks.getVoidPtr())[base_nblocks++] = b;
+}
+
+// Return the next BaseBlock with this checksum and size, or nullptr.
+// Start with *probe = 0; each call advances it.
+const PackUnix::BaseBlock *PackUnix::findBaseBlock(unsigned crc, unsigned sz_unc,
+                                                   unsigned *probe) const
+{
+    const unsigned *const htab = (const unsigned *) base_hash.getVoidPtr();
+    const BaseBlock *const bb = (const BaseBlock *) base_blocks.getVoidPtr();
+    unsigned const h0 = (crc ^ (sz_unc * 0x9e3779b1u)) & base_hash_mask;
+    for (;;) {
+        unsigned const k = htab[(h0 + *probe) & base_hash_mask];
+        if (k == 0)
+            return nullptr;
+        *probe += 1;
+        if (bb[k - 1].crc == crc && bb[k - 1].sz_unc == sz_unc)
+            return &bb[k - 1];
+    }
+}
+
+// If the uncompressed block ibuf[0, l) also is a block of --base=FILE, then
+// copy its compressed data to obuf instead of compressing it again, and set
+// ph and *ft as if compress() or compressWithFilters() had produced it.
+bool PackUnix::reuseBaseBlock(unsigned l, Filter *ft, int filter_strategy, unsigned b_extra)
+{
+    if (base_nblocks == 0)
+        return false;
+    unsigned const crc = upx_crc32(ibuf, l);
+    unsigned char const method = (unsigned char) ph_forced_method(ph.method);
+    unsigned probe = 0;
+    const BaseBlock *pb;
+    while ((pb = findBaseBlock(crc, l, &probe)) != nullptr) {
+        const BaseBlock &b = *pb;
+        if (b.b_extra != b_extra)
+            continue;
+        bool const stored = (b.sz_cpr == b.sz_unc);
+        if (!stored && b.b_method != method)
+            continue;  // the stub has only one decompressor
+        if (b.b_ftid) {
+            // the filter must be one which compressWithFilters() would try;
+            // the 0x80 family also depends on n_mru, which b_info lacks
+            if (ft == nullptr || filter_strategy == -3 || (b.b_ftid & 0xF0) == 0x80 ||
+                !Filter::isValidFilter(b.b_ftid, getFilters()) ||
+                (opt->filter > 0 && b.b_ftid != opt->filter))
+                continue;
+        }
+        // the checksum only selects a candidate; compare the actual contents.
+        // obuf is scratch space until compress() or this function fills it.
+        base_fi->seek(b.offset, SEEK_SET);
+        base_fi->readx(obuf, b.sz_cpr);
+        if (stored) {
+            if (memcmp(obuf, ibuf, l) != 0)
+                continue;
+        } else {
+            MemBuffer ubuf(l);
+            unsigned new_len = l;
+            int r = upx_decompress(obuf, b.sz_cpr, ubuf, &new_len, b.b_method, nullptr);
+            if (r != UPX_E_OK || new_len != l)
+                continue;
+            if (b.b_ftid) {
+                Filter tft(ph.level);
+                tft.init(b.b_ftid, 0);
+                tft.cto = b.b_cto8;
+                tft.unfilter(ubuf, l);
+            }
+            if (memcmp(ubuf, ibuf, l) != 0)
+                continue;
+        }
+
+        // same bookkeeping as compress()
+        ph.u_len = l;
+        ph.c_len = b.sz_cpr;
+        ph.saved_u_adler = ph.u_adler;
+        ph.u_adler = upx_adler32(ibuf, l, ph.u_adler);
+        ph.saved_c_adler = ph.c_adler;
+        ph.c_adler = upx_adler32(obuf, ph.c_len, ph.c_adler);
+        ph.filter = b.b_ftid;
+        ph.filter_cto = b.b_cto8;
+        if (ft && b.b_ftid) {
+            ft->init(b.b_ftid, ft->addvalue);
+            ft->cto = b.b_cto8;
+            ft->buf_len = l;
+            buildLoader(ft);  // as compressWithFilters() does for its best filter
+        }
+        return true;
+    }
+    return false;
+}
+
 // Consumes b_info header block and sz_cpr data block from input file 'fi'.
 // De-compresses; appends to output file 'fo' unless rewrite or peeking.
 // For "peeking" without writing: set (fo = nullptr), (is_rewrite = -1)
@@ -473,6 +727,11 @@ unsigned PackUnix::unpackExtent(unsigned wanted, OutputFile *fo,
     int is_rewrite // 0(false): write; 1(true): rewrite; -1: no write
 )
 {
+    if (is_rewrite >= 0 && 12 == szb_info && upx_get_num_threads() > 1) {
+        // "upx -d" and "upx -t" of modern b_info blocks
+        unpackExtentParallel(wanted, fo, c_adler, u_adler, is_rewrite > 0);
+        return 0;
+    }
     b_info hdr; memset(&hdr, 0, sizeof(hdr));
     unsigned inlen = 0; // output index (if-and-only-if peeking)
     while (wanted) {
@@ -550,6 +809,152 @@ unsigned PackUnix::unpackExtent(unsigned wanted, OutputFile *fo,
     return inlen;
 }
 
+// Parallel "upx -d" and "upx -t" of an extent of modern (12-byte b_info)
+// blocks, as a pipeline of three stages:
+//   - the I/O stage reads the b_info blocks of the next batch, and writes
+//     the blocks of the previous batch in file order
+//   - meanwhile the blocks of the current batch are decompressed,
+//     unfiltered and checksummed in parallel
+// Both stages are items of a single upx_parallel_for() per batch, so the
+// number of threads stays within --threads. The workers only see a copy
+// of ph taken before the pipeline starts; ph itself is updated from the
+// last block once all batches are written, as by the serial loop.
+// Only two batches are in flight, and a batch is limited both in the
+// number of blocks and in bytes, so memory use does not depend on the
+// size of the extent. The per-block checksums are chained in file order
+// by upx_adler32_combine(), so c_adler and u_adler end up exactly as
+// computed by the serial loop in unpackExtent().
+void PackUnix::unpackExtentParallel(unsigned wanted, OutputFile *fo,
+    unsigned &c_adler, unsigned &u_adler, bool is_rewrite)
+{
+    struct Block {
+        b_info hdr;
+        unsigned sz_unc, sz_cpr;
+        unsigned c_adler, u_adler;
+        MemBuffer ibuf, obuf;
+    };
+    struct Batch {
+        Block blocks[64];
+        unsigned n = 0;
+    };
+    Batch batches[2];
+    PackHeader const bph0 = ph; // method and level for the workers
+    b_info last_hdr; memset(&last_hdr, 0, sizeof(last_hdr));
+    unsigned const max_blocks = UPX_MIN(2 * upx_get_num_threads(), 64u);
+    unsigned max_bytes = 128 * 1024 * 1024;
+    if (upx_get_max_memory() != 0) // two batches are in flight
+        max_bytes = (unsigned) UPX_MIN((upx_uint64_t) max_bytes, upx_get_max_memory() / 8);
+
+    auto read_batch = [&](Batch &batch) {
+        unsigned bytes = 0;
+        for (batch.n = 0; wanted && batch.n < max_blocks && bytes < max_bytes; batch.n++) {
+            Block &b = batch.blocks[batch.n];
+            memset(&b.hdr, 0, sizeof(b.hdr));
+            fi->readx(&b.hdr, szb_info);
+            int const sz_unc = get_te32(&b.hdr.sz_unc);
+            int const sz_cpr = get_te32(&b.hdr.sz_cpr);
+            if (sz_unc <= 0 || sz_cpr <= 0)
+                throwCantUnpack("corrupt b_info");
+            if (sz_cpr > sz_unc || sz_unc > (int)blocksize)
+                throwCantUnpack("corrupt b_info");
+            // mismatched end-of-block; with output the serial loop does not
+            // check this, but its "wanted" then wraps around and it fails
+            // later on the data after the extent
+            if (wanted < (unsigned)sz_unc)
+                throwCantUnpack("corrupt b_info");
+            b.sz_unc = sz_unc;
+            b.sz_cpr = sz_cpr;
+            if (b.ibuf.getSize() < b.sz_cpr) {
+                b.ibuf.dealloc();
+                b.ibuf.alloc(b.sz_cpr);
+            }
+            fi->readx(b.ibuf, sz_cpr);
+            total_in += sz_cpr;
+            wanted -= sz_unc;
+            bytes += sz_unc + sz_cpr;
+        }
+    };
+    auto decompress_block = [&](Block &b) {
+        b.c_adler = upx_adler32(b.ibuf, b.sz_cpr);
+        if (b.sz_cpr < b.sz_unc) { // block was compressed
+            if (b.obuf.getSize() < MemBuffer::getSizeForDecompression(b.sz_unc)) {
+                b.obuf.dealloc();
+                b.obuf.allocForDecompression(b.sz_unc);
+            }
+            PackHeader bph = bph0; // ph_decompress() updates its PackHeader
+            bph.u_len = b.sz_unc;
+            bph.c_len = b.sz_cpr;
+            ph_decompress(bph, b.ibuf, b.obuf, false, nullptr);
+            if (b.hdr.b_ftid) {
+                Filter ft(bph0.level);
+                ft.init(b.hdr.b_ftid, 0);
+                ft.cto = b.hdr.b_cto8;
+                ft.unfilter(b.obuf, b.sz_unc);
+            }
+            b.u_adler = upx_adler32(b.obuf, b.sz_unc);
+        }
+        else
+            b.u_adler = upx_adler32(b.ibuf, b.sz_unc);
+    };
+    auto write_batch = [&](Batch &batch) {
+        for (unsigned i = 0; i < batch.n; i++) {
+            Block &b = batch.blocks[i];
+            c_adler = upx_adler32_combine(c_adler, b.c_adler, b.sz_cpr);
+            u_adler = upx_adler32_combine(u_adler, b.u_adler, b.sz_unc);
+            if (fo) {
+                MemBuffer &data = b.sz_cpr < b.sz_unc ? b.obuf : b.ibuf;
+                if (is_rewrite) {
+                    fo->rewrite(data, b.sz_unc);
+                }
+                else {
+                    fo->write(data, b.sz_unc);
+                    total_out += b.sz_unc;
+                }
+            }
+        }
+        if (batch.n)
+            last_hdr = batch.blocks[batch.n - 1].hdr;
+        batch.n = 0;
+    };
+
+    read_batch(batches[0]);
+    for (unsigned k = 0; batches[k & 1].n; k++) {
+        Batch &cur = batches[k & 1];
+        Batch &other = batches[~k & 1];
+        // item 0 is the I/O stage; the others decompress one block each
+        upx_parallel_for(1 + cur.n, [&](size_t i) {
+            if (i == 0) {
+                write_batch(other); // the previous batch, if any
+                read_batch(other);  // the next batch, if any
+            }
+            else
+                decompress_block(cur.blocks[i - 1]);
+        });
+        if (!other.n)
+            write_batch(cur); // the last batch
+    }
+    if (get_te32(&last_hdr.sz_unc)) { // as left by the serial loop
+        ph.u_len = get_te32(&last_hdr.sz_unc);
+        ph.c_len = get_te32(&last_hdr.sz_cpr);
+        ph.filter_cto = last_hdr.b_cto8;
+    }
+}
+
+// With --max-memory only a few blocks are resident at any time: the
+// input block, its compressed output, the copies of the parallel trials
+// and the state of the compressor, which is about 12 times the block
+// size for LZMA. So cap the block size at 1/16 of the limit; the stub
+// decompresses each extent block by block anyway.
+unsigned PackUnix::capBlocksize(unsigned size)
+{
+    upx_uint64_t const max_memory = upx_get_max_memory();
+    if (max_memory == 0)
+        return size;
+    upx_uint64_t cap = (max_memory / 16) & ~(upx_uint64_t)0xfff;  // page multiple
+    cap = UPX_MAX(cap, (upx_uint64_t)64 * 1024);
+    return (unsigned) UPX_MIN((upx_uint64_t)size, cap);
+}
+
 /*************************************************************************
 // Generic Unix canUnpack().
 **************************************************************************/
@@ -709,4 +1114,133 @@ void PackUnix::unpack(OutputFile *fo)
         throwChecksumError();
 }
 
+/*************************************************************************
+// test the parallel unpackExtent() against the serial loop
+**************************************************************************/
+
+namespace {
+struct TestPackUnix final : public PackUnix {
+    explicit TestPackUnix(InputFile *f) : PackUnix(f) {}
+    virtual int getFormat() const override { return UPX_F_LINUX_ELF64_AMD64; }
+    virtual const char *getName() const override { return "test/unix"; }
+    virtual const char *getFullName(const Options *) const override { return "test/unix"; }
+    virtual const int *getCompressionMethods(int, int) const override { return nullptr; }
+    virtual void buildLoader(const Filter *) override {}
+    virtual Linker *newLinker() const override { return nullptr; }
+    virtual void patchLoader() override {}
+    virtual void updateLoader(OutputFile *) override {}
+    typedef PackUnix::b_info b_info;
+    unsigned lastBlockSize() const { return ph.u_len; }
+
+    // "upx -t" of the b_info blocks at the start of the file
+    void testExtent(unsigned wanted, unsigned bsize, unsigned threads, unsigned *c_adler,
+                    unsigned *u_adler) {
+        const unsigned saved_threads = opt->threads;
+        opt->threads = threads;
+        szb_info = sizeof(b_info);
+        blocksize = bsize;
+        ibuf.dealloc();
+        ibuf.alloc(blocksize + OVERHEAD);
+        ph.method = M_NRV2B_LE32;
+        ph.level = 6;
+        total_in = total_out = 0;
+        fi->seek(0, SEEK_SET);
+        *c_adler = *u_adler = 1; // adler32 of nothing
+        try {
+            unpackExtent(wanted, nullptr, *c_adler, *u_adler, false, 0);
+        } catch (...) {
+            opt->threads = saved_threads;
+            throw;
+        }
+        opt->threads = saved_threads;
+    }
+};
+} // namespace
+
+TEST_CASE("PackUnix::unpackExtentParallel") {
+    // blocks: plain, filtered, stored, filtered, plain, short and filtered
+    constexpr unsigned bsize = 16384;
+    static const unsigned sizes[] = {bsize, bsize, bsize, bsize, bsize, 5000};
+    static const unsigned char ftids[] = {0, 0x49, 0, 0x46, 0, 0x49};
+    constexpr unsigned nblocks = TABLESIZE(sizes);
+    unsigned u_total = 0;
+    for (unsigned i = 0; i < nblocks; i++)
+        u_total += sizes[i];
+    MemBuffer udata(u_total);
+    MemBuffer fdata(bsize);
+    MemBuffer cdata(MemBuffer::getSizeForCompression(bsize));
+    upx_uint32_t seed = 0x1234567;
+    auto rnd = [&seed]() {
+        seed = seed * 1103515245 + 12345;
+        return seed >> 16;
+    };
+
+    char name[64];
+    upx_safe_snprintf(name, sizeof(name), "upx-doctest-p_unix-%u.tmp", (unsigned) getpid());
+    {
+        OutputFile fo;
+        fo.open(name, O_WRONLY | O_CREAT | O_TRUNC | O_BINARY, 0600);
+        byte *u = udata;
+        for (unsigned i = 0; i < nblocks; i++) {
+            const unsigned len = sizes[i];
+            for (unsigned j = 0; j < len; j++) {
+                if (i == 2) // incompressible
+                    u[j] = byte(rnd());
+                else if (j % 8 == 0 && j + 5 <= len) // x86 calls for the filters
+                    u[j] = 0xe8;
+                else
+                    u[j] = byte("upx_unpack"[rnd() % 10]);
+            }
+            memcpy(fdata, u, len);
+            Filter ft(6);
+            ft.init(ftids[i], 0);
+            if (ftids[i] != 0)
+                CHECK(ft.filter(fdata, len));
+            unsigned c_len = 0;
+            int r = upx_compress(fdata, len, cdata, &c_len, nullptr, M_NRV2B_LE32, 6, nullptr,
+                                 nullptr);
+            CHECK(r == UPX_E_OK);
+            TestPackUnix::b_info hdr;
+            memset(&hdr, 0, sizeof(hdr));
+            set_le32(&hdr.sz_unc, len);
+            if (c_len < len) {
+                set_le32(&hdr.sz_cpr, c_len);
+                hdr.b_method = M_NRV2B_LE32;
+                hdr.b_ftid = ftids[i];
+                hdr.b_cto8 = ft.cto;
+                fo.write(&hdr, sizeof(hdr));
+                fo.write(cdata, c_len);
+            } else { // stored
+                CHECK(ftids[i] == 0);
+                set_le32(&hdr.sz_cpr, len);
+                fo.write(&hdr, sizeof(hdr));
+                fo.write(u, len);
+            }
+            u += len;
+        }
+        fo.closex();
+    }
+
+    InputFile fi;
+    fi.open(name, O_RDONLY | O_BINARY);
+    {
+        TestPackUnix pu(&fi);
+        unsigned c1, u1, c4, u4;
+        pu.testExtent(u_total, bsize, 1, &c1, &u1);
+        pu.testExtent(u_total, bsize, 4, &c4, &u4);
+        CHECK(u1 == upx_adler32(udata, u_total));
+        CHECK(u4 == u1);
+        CHECK(c4 == c1);
+        // ph is left as by the last block in both paths
+        CHECK(pu.lastBlockSize() == sizes[nblocks - 1]);
+        // a "wanted" length which ends inside a block is rejected by both
+        CHECK_THROWS(pu.testExtent(u_total - 1, bsize, 1, &c1, &u1));
+        CHECK_THROWS(pu.testExtent(u_total - 1, bsize, 4, &c4, &u4));
+        CHECK_THROWS(pu.testExtent(bsize + 1, bsize, 1, &c1, &u1));
+        CHECK_THROWS(pu.testExtent(bsize + 1, bsize, 4, &c4, &u4));
+    }
+    fi.closex();
+    FileBase::unlink(name);
+}
+
 /* vim:set ts=4 sw=4 et: */
@@ -73,6 +73,11 @@ protected:
     virtual void writePackHeader(OutputFile *fo);
 
     virtual bool checkCompressionRatio(unsigned, unsigned) const override;
+    // the stubs only depend on the method, the filter and methods_used
+    virtual bool getLoaderSizeKey(unsigned *extra) const override {
+        *extra = methods_used;
+        return true;
+    }
 
 protected:
     struct Extent {
@@ -88,7 +93,32 @@ protected:
         bool first_PF_X,
         int is_rewrite = false  // 0(false): write; 1(true): rewrite; -1: no write
         );
-    unsigned total_in, total_out;  // unpack
+    void unpackExtentParallel(unsigned wanted, OutputFile *fo,
+        unsigned &c_adler, unsigned &u_adler, bool is_rewrite);
+    static unsigned capBlocksize(unsigned size);  // --max-memory
+
+    // --base: blocks of an older packed file which packExtent() may copy
+    struct BaseBlock {
+        unsigned offset;  // of the compressed data in base_fi
+        unsigned sz_unc;
+        unsigned sz_cpr;
+        unsigned crc;  // of the uncompressed and unfiltered data
+        unsigned char b_method;
+        unsigned char b_ftid;
+        unsigned char b_cto8;
+        unsigned char b_extra;
+    };
+    void loadBase();
+    bool reuseBaseBlock(unsigned l, Filter *ft, int filter_strategy, unsigned b_extra);
+    void addBaseBlock(const BaseBlock &b);
+    const BaseBlock *findBaseBlock(unsigned crc, unsigned sz_unc, unsigned *probe) const;
+    OwningPointer(InputFile) base_fi;  // owner; open while packing, read on demand
+    MemBuffer base_blocks;  // BaseBlock[base_nblocks]
+    unsigned base_nblocks;
+    MemBuffer base_hash;  // open addressing on (crc, sz_unc); 1 + index into base_blocks
+    unsigned base_hash_mask;
+    bool base_loaded;
+    upx_uint64_t total_in, total_out;  // unpack
 
     int exetype;  // 0: unknown; 1: ELF; 2: pre-ELF; -1: /bin/sh; -2: Java
     unsigned blocksize;
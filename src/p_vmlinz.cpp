@@ -150,6 +150,56 @@ static int is_pow2(unsigned const x)
     return !(x & (x - 1));
 }
 
+// gunzip the gzip member at in[0, in_len) into ibuf[] in a single pass;
+// return the decompressed size (or -1 on error) and the compressed size
+// in *gz_used.
+// The buffer is sized by the ISIZE field of the gzip trailer when that is
+// plausible (it is exact when in_len is the exact payload length); else it
+// grows by 1.5x, keeping what has been inflated so far.
+static int gunzipKernel(MemBuffer &ibuf, const upx_byte *in, unsigned in_len, unsigned *gz_used)
+{
+    *gz_used = 0;
+    unsigned size = mem_size(3, in_len);
+    unsigned const isize = get_le32(in + in_len - 4);
+    if (in_len < isize && isize / 32 < in_len)
+        size = isize;
+    if (ibuf.getSize() < size) {
+        ibuf.dealloc();
+        ibuf.alloc(size);
+    }
+
+    z_stream s;
+    memset(&s, 0, sizeof(s));
+    if (inflateInit2(&s, 16 + MAX_WBITS) != Z_OK) // gzip header and trailer
+        return -1;
+    s.next_in = const_cast<upx_byte *>(in);
+    s.avail_in = in_len;
+    s.next_out = ibuf;
+    s.avail_out = ibuf.getSize();
+    int klen = -1;
+    for (;;) {
+        int const zr = inflate(&s, Z_NO_FLUSH);
+        if (zr == Z_STREAM_END) { // also verifies CRC32 and ISIZE
+            klen = (int) s.total_out;
+            *gz_used = (unsigned) s.total_in;
+            break;
+        }
+        if ((zr != Z_OK && zr != Z_BUF_ERROR) || s.avail_out != 0)
+            break; // bad or truncated data
+        // grow the output buffer
+        unsigned const done = (unsigned) s.total_out;
+        MemBuffer tmp(done);
+        memcpy(tmp, ibuf, done);
+        ibuf.dealloc();
+        ibuf.alloc(mem_size(1, (upx_uint64_t) done + done / 2));
+        memcpy(ibuf, tmp, done);
+        s.next_out = ibuf + done;
+        s.avail_out = ibuf.getSize() - done;
+    }
+    inflateEnd(&s);
+    return klen;
+}
+
 // read full kernel into obuf[], gzip-decompress into ibuf[],
 // return decompressed size
 int PackVmlinuzI386::decompressKernel()
@@ -248,7 +298,9 @@ int PackVmlinuzI386::decompressKernel()
         if (off < 0)
             break;
         gzoff += off;
-        const int gzlen = (h.version < 0x208) ? (file_size - gzoff) : h.payload_length;
+        int gzlen = (h.version < 0x208) ? (file_size - gzoff) : h.payload_length;
+        if (gzlen > file_size - gzoff)
+            gzlen = file_size - gzoff;
         if (gzlen < 256)
             break;
         // check gzip flag byte
@@ -258,38 +310,8 @@ int PackVmlinuzI386::decompressKernel()
         //printf("found gzip header at offset %d\n", gzoff);
 
         // try to decompress
-        int klen;
-        int fd;
-        upx_off_t fd_pos;
-        for (;;)
-        {
-            klen = -1;
-            fd_pos = -1;
-            // open
-            fi->seek(gzoff, SEEK_SET);
-            fd = dup(fi->getFd());
-            if (fd < 0)
-                break;
-            gzFile zf = gzdopen(fd, "rb");
-            if (zf == nullptr)
-                break;
-            // estimate gzip-decompressed kernel size & alloc buffer
-            if (ibuf.getSize() == 0)
-                ibuf.alloc(gzlen * 3);
-            // decompress
-            klen = gzread(zf, ibuf, ibuf.getSize());
-            fd_pos = lseek(fd, 0, SEEK_CUR);
-            gzclose(zf);
-            fd = -1;
-            if (klen != (int)ibuf.getSize())
-                break;
-            // realloc and try again
-            unsigned s = ibuf.getSize();
-            ibuf.dealloc();
-            ibuf.alloc(3 * s / 2);
-        }
-        if (fd >= 0)
-            (void) close(fd);
+        unsigned gz_used;
+        int const klen = gunzipKernel(ibuf, obuf + gzoff, gzlen, &gz_used);
         if (klen <= 0)
             continue;
 
@@ -343,9 +365,9 @@ int PackVmlinuzI386::decompressKernel()
             return klen;
 
         // some checks
-        if (fd_pos != file_size)
+        if (gzoff + gz_used != file_size)
         {
-            NO_printf("fd_pos: %lld, file_size: %lld\n", fd_pos, file_size);
+            NO_printf("gz_end: %u, file_size: %lld\n", gzoff + gz_used, file_size);
 
             // linux-2.6.21.5/arch/i386/boot/compressed/vmlinux.lds
             // puts .data.compressed ahead of .text, .rodata, etc;
@@ -840,38 +862,8 @@ int PackVmlinuzARMEL::decompressKernel()
         //printf("found gzip header at offset %d\n", gzoff);
 
         // try to decompress
-        int klen;
-        int fd;
-        upx_off_t fd_pos;
-        for (;;)
-        {
-            klen = -1;
-            fd_pos = -1;
-            // open
-            fi->seek(gzoff, SEEK_SET);
-            fd = dup(fi->getFd());
-            if (fd < 0)
-                break;
-            gzFile zf = gzdopen(fd, "rb");
-            if (zf == nullptr)
-                break;
-            // estimate gzip-decompressed kernel size & alloc buffer
-            if (ibuf.getSize() == 0)
-                ibuf.alloc(gzlen * 3);
-            // decompress
-            klen = gzread(zf, ibuf, ibuf.getSize());
-            fd_pos = lseek(fd, 0, SEEK_CUR);
-            gzclose(zf);
-            fd = -1;
-            if (klen != (int)ibuf.getSize())
-                break;
-            // realloc and try again
-            unsigned const s = ibuf.getSize();
-            ibuf.dealloc();
-            ibuf.alloc(3 * s / 2);
-        }
-        if (fd >= 0)
-            (void) close(fd);
+        unsigned gz_used;
+        int const klen = gunzipKernel(ibuf, obuf + gzoff, gzlen, &gz_used);
         if (klen <= 0)
             continue;
 
@@ -882,8 +874,8 @@ int PackVmlinuzARMEL::decompressKernel()
             return klen;
 
         // some checks
-        if (fd_pos != file_size) {
-            //printf("fd_pos: %ld, file_size: %ld\n", (long)fd_pos, (long)file_size);
+        if (gzoff + gz_used != file_size) {
+            //printf("gz_end: %u, file_size: %ld\n", gzoff + gz_used, (long)file_size);
         }
 
     //head_ok:
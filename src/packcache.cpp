@@ -0,0 +1,651 @@
+/* packcache.cpp -- persistent cache of packed files
+
+   This file is part of the UPX executable compressor.
+
+   Copyright (C) 1996-2024 Markus Franz Xaver Johannes Oberhumer
+   Copyright (C) 1996-2024 Laszlo Molnar
+   All Rights Reserved.
+
+   UPX and the UCL library are free software; you can redistribute them
+   and/or modify them under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of
+   the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; see the file COPYING.
+   If not, write to the Free Software Foundation, Inc.,
+   59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+
+   Markus F.X.J. Oberhumer              Laszlo Molnar
+   <markus@oberhumer.com>               <ezerotven+github@gmail.com>
+ */
+
+#include "conf.h"
+#include "file.h"
+#include "packcache.h"
+#include "packhead.h"
+#include "packmast.h"
+#include "ui.h"
+#include "util/membuffer.h"
+
+// bump this when the layout of the cache entries changes
+static const unsigned cache_format_version = 1;
+
+/*************************************************************************
+// util
+**************************************************************************/
+
+static upx_uint64_t fnv1a_64(const void *buf, size_t len,
+                             upx_uint64_t h = 0xcbf29ce484222325ULL) noexcept {
+    const byte *p = (const byte *) buf;
+    for (size_t i = 0; i < len; i++)
+        h = (h ^ p[i]) * 0x100000001b3ULL;
+    return h;
+}
+
+// copy the rest of fi to fo
+static void copy_contents(InputFile *fi, OutputFile *fo) may_throw {
+    MemBuffer buf(1024 * 1024);
+    for (;;) {
+        int bytes = fi->read(buf, buf.getSize());
+        if (bytes <= 0)
+            break;
+        fo->write(buf, bytes);
+    }
+}
+
+static void touch_file(const char *name) noexcept {
+#if HAVE_UTIME
+    int r = utime(name, nullptr); // set the times to now; see PackCache::evict()
+    UNUSED(r);
+#else
+    UNUSED(name);
+#endif
+}
+
+/*************************************************************************
+// keys
+**************************************************************************/
+
+namespace {
+// FNV-1a over the values of the options, so that padding bytes and
+// options which do not affect the packed file never change the key
+struct KeyHash final {
+    upx_uint64_t h = 0xcbf29ce484222325ULL;
+
+    template <class T>
+    void add(const T &v) noexcept {
+        static_assert(std::is_integral_v<T> || std::is_enum_v<T>);
+        const upx_uint64_t x = upx_uint64_t(v);
+        h = fnv1a_64(&x, sizeof(x), h);
+    }
+    template <class T, T a, T b, T c>
+    void add(const OptVar<T, a, b, c> &v) noexcept {
+        add(v.value);
+        add(v.is_set);
+    }
+    template <class T, bool IsThirdTrue>
+    void add(const upx::TriBool<T, IsThirdTrue> &v) noexcept {
+        add(int(v.getValue()));
+    }
+    void addString(const char *s) noexcept {
+        add(s != nullptr);
+        if (s != nullptr)
+            h = fnv1a_64(s, strlen(s) + 1, h);
+    }
+};
+} // namespace
+
+/*static*/ upx_uint64_t PackCache::optionsKey(const Options *o, const char *name) noexcept {
+    // NOTE: add new options here if they affect the packed file; the rest,
+    // e.g. verbose, threads, output_name and the hints, must not be added
+    KeyHash k;
+    k.add(o->cmd);
+    // compression options
+    k.add(o->method);
+    k.add(o->method_lzma_seen);
+    k.add(o->method_nrv2b_seen);
+    k.add(o->method_nrv2d_seen);
+    k.add(o->method_nrv2e_seen);
+    k.add(o->level);
+    k.add(o->filter);
+    k.add(o->ultra_brute);
+    k.add(o->all_methods);
+    k.add(o->all_methods_use_lzma);
+    k.add(o->all_filters);
+    k.add(o->no_filter);
+    k.add(o->prefer_ucl);
+    k.add(o->exact);
+    // other global options
+    k.add(o->force);
+    k.add(o->small);
+    k.add(o->max_memory); // the ELF block size
+    k.add(o->overlay);
+    k.add(o->cpu_x86);
+    k.add(o->debug.disable_random_id);
+    k.addString(o->debug.fake_stub_version);
+    k.addString(o->debug.fake_stub_year);
+    k.add(o->debug.use_random_method);
+    k.add(o->debug.use_random_filter);
+    // compression runtime parameters
+    k.add(o->crp.crp_bzip2.dummy);
+    k.add(o->crp.crp_lzma.pos_bits);
+    k.add(o->crp.crp_lzma.lit_pos_bits);
+    k.add(o->crp.crp_lzma.lit_context_bits);
+    k.add(o->crp.crp_lzma.dict_size);
+    k.add(o->crp.crp_lzma.fast_mode);
+    k.add(o->crp.crp_lzma.num_fast_bytes);
+    k.add(o->crp.crp_lzma.match_finder_cycles);
+    k.add(o->crp.crp_lzma.max_num_probs);
+    k.add(o->crp.crp_lzma.autotune);
+    k.add(o->crp.crp_ucl.bb_endian);
+    k.add(o->crp.crp_ucl.bb_size);
+    k.add(o->crp.crp_ucl.max_offset);
+    k.add(o->crp.crp_ucl.max_match);
+    k.add(o->crp.crp_ucl.s_level);
+    k.add(o->crp.crp_ucl.h_level);
+    k.add(o->crp.crp_ucl.p_level);
+    k.add(o->crp.crp_ucl.c_flags);
+    k.add(o->crp.crp_ucl.m_size);
+    k.add(o->crp.crp_zlib.mem_level);
+    k.add(o->crp.crp_zlib.window_bits);
+    k.add(o->crp.crp_zlib.strategy);
+    k.add(o->crp.crp_zstd.dummy);
+    // options for the executable formats
+    k.add(o->atari_tos.split_segments);
+    k.add(o->darwin_macho.force_macos);
+    k.add(o->djgpp2_coff.coff);
+    k.add(o->dos_exe.force_stub);
+    k.add(o->dos_exe.no_reloc);
+    k.add(o->o_unix.blocksize);
+    k.add(o->o_unix.force_execve);
+    k.add(o->o_unix.is_ptinterp);
+    k.add(o->o_unix.use_ptinterp);
+    k.add(o->o_unix.make_ptinterp);
+    k.add(o->o_unix.unmap_all_pages);
+    k.add(o->o_unix.osabi0);
+    k.add(o->o_unix.preserve_build_id);
+    k.add(o->o_unix.android_shlib);
+    k.add(o->o_unix.force_pie);
+    k.addString(o->o_unix.base); // not cached anyway, see work.cpp
+    k.add(o->ps1_exe.boot_only);
+    k.add(o->ps1_exe.no_align);
+    k.add(o->ps1_exe.do_8bit);
+    k.add(o->ps1_exe.do_8mib);
+    k.add(o->watcom_le.le);
+    k.add(o->win32_pe.compress_exports);
+    k.add(o->win32_pe.compress_icons);
+    k.add(o->win32_pe.compress_resources);
+    for (size_t i = 0; i < TABLESIZE(o->win32_pe.compress_rt); i++)
+        k.add(o->win32_pe.compress_rt[i]);
+    k.add(o->win32_pe.strip_relocs);
+    k.addString(o->win32_pe.keep_resource);
+    // dos/com and dos/sys are recognized by the file extension
+    k.add(fn_has_ext(name, "com"));
+    k.add(fn_has_ext(name, "sys"));
+    k.addString(UPX_VERSION_STRING);
+    k.add(cache_format_version);
+    return k.h;
+}
+
+void PackCache::open(const char *dir_, InputFile *fi, const char *iname_) may_throw {
+    // leave room for the longest name in makePath()
+    if (strlen(dir_) + 1 + sizeof(full_key) + 16 > sizeof(dir))
+        throwIOException("--cache-dir name too long");
+    strcpy(dir, dir_);
+    iname = iname_;
+    (void) acc_mkdir(dir, 0777); // IGNORE_ERROR; affected by umask
+
+    // three independent checksums of the contents
+    unsigned crc = 0, adler = 1;
+    upx_uint64_t fnv = 0xcbf29ce484222325ULL;
+    MemBuffer buf(1024 * 1024);
+    fi->seek(0, SEEK_SET);
+    for (;;) {
+        int bytes = fi->read(buf, buf.getSize());
+        if (bytes <= 0)
+            break;
+        crc = upx_crc32(raw_bytes(buf, bytes), bytes, crc);
+        adler = upx_adler32(raw_bytes(buf, bytes), bytes, adler);
+        fnv = fnv1a_64(raw_bytes(buf, bytes), bytes, fnv);
+    }
+    fi->seek(0, SEEK_SET);
+    upx_safe_snprintf(content_key, sizeof(content_key), "%016llx%08x%08x%016llx",
+                      (unsigned long long) fi->st_size(), crc, adler, (unsigned long long) fnv);
+    upx_safe_snprintf(full_key, sizeof(full_key), "%s-%016llx", content_key,
+                      (unsigned long long) optionsKey(opt, iname));
+}
+
+void PackCache::makePath(char *path, const char *key, const char *ext) const may_throw {
+    upx_safe_snprintf(path, ACC_FN_PATH_MAX + 1, "%s/%s%s", dir, key, ext);
+}
+
+/*************************************************************************
+// lookup
+**************************************************************************/
+
+bool PackCache::fetch(OutputFile *fo) may_throw {
+    if (!isOpen())
+        return false;
+    makePath(entry_path, full_key, ".upx");
+    struct stat st = {};
+    if (stat(entry_path, &st) != 0 || !S_ISREG(st.st_mode))
+        return false;
+    InputFile cfi;
+    cfi.open(entry_path, O_RDONLY | O_BINARY);
+    PackHeader ph;
+    char err[256];
+    if (!PackMaster::findPackHeader(&cfi, &ph, err, sizeof(err))) {
+        // not written by store(); never use it
+        cfi.closex();
+        (void) FileBase::unlink_noexcept(entry_path); // IGNORE_ERROR
+        return false;
+    }
+    const char *format_name = PackMaster::getFormatName(&cfi, ph.format);
+    cfi.seek(0, SEEK_SET);
+    copy_contents(&cfi, fo);
+    cfi.closex();
+    touch_file(entry_path);
+    UiPacker::uiPackCached(iname, &ph, fo->getBytesWritten(), format_name);
+    return true;
+}
+
+bool PackCache::getHint(int *method, int *filter) const noexcept {
+    if (!isOpen())
+        return false;
+    int m = 0, ft = 0, n = 0;
+    try {
+        char path[ACC_FN_PATH_MAX + 1];
+        makePath(path, content_key, ".hint");
+        FILE *f = fopen(path, "rb");
+        if (f == nullptr)
+            return false;
+        n = fscanf(f, "%d %d", &m, &ft);
+        fclose(f);
+    } catch (...) {
+        return false;
+    }
+    if (n != 2 || m <= 0 || ft < 0 || ft > 255)
+        return false;
+    *method = m;
+    *filter = ft;
+    return true;
+}
+
+/*************************************************************************
+// update
+**************************************************************************/
+
+void PackCache::store(const char *packed_name) noexcept {
+    if (!isOpen())
+        return;
+    unsigned pid = 0;
+#if HAVE_GETPID
+    pid = (unsigned) getpid();
+#endif
+    char tname[ACC_FN_PATH_MAX + 1];
+    tname[0] = 0;
+    try {
+        char ext[32];
+        upx_safe_snprintf(ext, sizeof(ext), ".%u.tmp", pid);
+        // the packed file
+        InputFile pfi;
+        pfi.open(packed_name, O_RDONLY | O_BINARY);
+        PackHeader ph;
+        char err[256];
+        if (!PackMaster::findPackHeader(&pfi, &ph, err, sizeof(err)))
+            return; // should not happen
+        pfi.seek(0, SEEK_SET);
+        makePath(tname, full_key, ext);
+        OutputFile fo;
+        fo.open(tname, O_WRONLY | O_CREAT | O_EXCL | O_BINARY, 0666);
+        copy_contents(&pfi, &fo);
+        fo.closex();
+        pfi.closex();
+        makePath(entry_path, full_key, ".upx");
+        FileBase::rename(tname, entry_path);
+        // the hint
+        char hint[64];
+        int hint_len = upx_safe_snprintf(hint, sizeof(hint), "%d %d\n", ph.method, ph.filter);
+        makePath(tname, content_key, ext);
+        fo.open(tname, O_WRONLY | O_CREAT | O_EXCL | O_BINARY, 0666);
+        fo.write(hint, hint_len);
+        fo.closex();
+        char hint_path[ACC_FN_PATH_MAX + 1];
+        makePath(hint_path, content_key, ".hint");
+        FileBase::rename(tname, hint_path);
+        tname[0] = 0;
+        evict();
+    } catch (...) {
+        // the cache is only an optimization; e.g. the directory may be read-only
+        if (tname[0])
+            (void) FileBase::unlink_noexcept(tname); // IGNORE_ERROR
+    }
+}
+
+// The names of the files in the cache directory, with lower-case hex keys:
+//   <content_key>-<options>.upx, <content_key>.hint and <key>.<pid>.tmp
+// Files with other names are never touched.
+enum { NAME_OTHER, NAME_ENTRY, NAME_TMP };
+
+static bool is_lower_hex(const char *s, size_t n) noexcept {
+    for (size_t i = 0; i < n; i++) // also stops at the terminating NUL
+        if (!((s[i] >= '0' && s[i] <= '9') || (s[i] >= 'a' && s[i] <= 'f')))
+            return false;
+    return true;
+}
+
+static int classify_name(const char *name) noexcept {
+    if (!is_lower_hex(name, 48))
+        return NAME_OTHER;
+    const char *p = name + 48;
+    const bool has_options = p[0] == '-';
+    if (has_options) {
+        if (!is_lower_hex(p + 1, 16))
+            return NAME_OTHER;
+        p += 1 + 16;
+    }
+    if (strcmp(p, has_options ? ".upx" : ".hint") == 0)
+        return NAME_ENTRY;
+    if (p[0] != '.' || !(p[1] >= '0' && p[1] <= '9'))
+        return NAME_OTHER;
+    for (p += 1; *p >= '0' && *p <= '9'; p++) {
+    }
+    return strcmp(p, ".tmp") == 0 ? NAME_TMP : NAME_OTHER;
+}
+
+#if HAVE_DIRENT_H
+namespace {
+struct CacheFile final {
+    time_t mtime;
+    upx_uint64_t size;
+    char name[48 + 1 + 16 + 5 + 1]; // NAME_ENTRY
+};
+} // namespace
+
+static int __acc_cdecl_qsort compare_mtime(const void *aa, const void *bb) {
+    const CacheFile *a = (const CacheFile *) aa;
+    const CacheFile *b = (const CacheFile *) bb;
+    if (a->mtime != b->mtime)
+        return a->mtime < b->mtime ? -1 : 1;
+    return strcmp(a->name, b->name);
+}
+#endif
+
+// Remove the least recently used entries until the cache fits into
+// "--cache-size"; fetch() refreshes the mtime of an entry. The directory
+// is scanned once, and then the entries are removed oldest first.
+// Temporary files older than an hour are left over from a store() that
+// was interrupted, and are removed as well.
+void PackCache::evict() const may_throw {
+#if HAVE_DIRENT_H
+    const upx_uint64_t limit = upx_uint64_t(opt->cache_size ? opt->cache_size : 1024) << 20;
+    const time_t stale_time = time(nullptr) - 3600;
+    MemBuffer files_buf[2]; // CacheFile[capacity]; grown by doubling
+    unsigned cur = 0, nfiles = 0, capacity = 0;
+    upx_uint64_t total = 0;
+    DIR *d = opendir(dir);
+    if (d == nullptr)
+        return;
+    try {
+        while (const struct dirent *e = readdir(d)) {
+            const int kind = classify_name(e->d_name);
+            if (kind == NAME_OTHER)
+                continue;
+            char path[ACC_FN_PATH_MAX + 1];
+            makePath(path, e->d_name, "");
+            struct stat st = {};
+            if (stat(path, &st) != 0 || !S_ISREG(st.st_mode))
+                continue;
+            if (kind == NAME_TMP) {
+                if (st.st_mtime < stale_time)
+                    (void) FileBase::unlink_noexcept(path); // IGNORE_ERROR
+                continue;
+            }
+            if (nfiles == capacity) {
+                capacity = capacity ? 2 * capacity : 256;
+                files_buf[cur ^ 1].alloc(mem_size(sizeof(CacheFile), capacity));
+                if (nfiles)
+                    memcpy(files_buf[cur ^ 1], files_buf[cur], sizeof(CacheFile) * nfiles);
+                files_buf[cur].dealloc();
+                cur ^= 1;
+            }
+            CacheFile *f = (CacheFile *) raw_bytes(files_buf[cur], sizeof(CacheFile) * capacity);
+            f += nfiles++;
+            f->mtime = st.st_mtime;
+            f->size = st.st_size;
+            strcpy(f->name, e->d_name); // length checked by classify_name()
+            total += st.st_size;
+        }
+    } catch (...) {
+        closedir(d);
+        throw;
+    }
+    closedir(d);
+    if (total <= limit)
+        return;
+    CacheFile *files = (CacheFile *) raw_bytes(files_buf[cur], sizeof(CacheFile) * nfiles);
+    upx_qsort(files, nfiles, sizeof(CacheFile), compare_mtime);
+    for (unsigned i = 0; i < nfiles && total > limit; i++) {
+        char path[ACC_FN_PATH_MAX + 1];
+        makePath(path, files[i].name, "");
+        if (FileBase::unlink_noexcept(path))
+            total -= files[i].size;
+    }
+#endif
+}
+
+/*************************************************************************
+//
+**************************************************************************/
+
+TEST_CASE("PackCache::optionsKey") {
+    Options a, b;
+    a.reset();
+    a.cmd = CMD_COMPRESS;
+    memcpy(&b, &a, sizeof(b)); // struct copy
+    const upx_uint64_t k = PackCache::optionsKey(&a, "a.out");
+    CHECK(PackCache::optionsKey(&b, "a.out") == k);
+    b.verbose = 3;
+    b.threads = 4;
+    b.output_name = "packed";
+    b.hint_method = M_LZMA;
+    CHECK(PackCache::optionsKey(&b, "dir/a.out") == k);
+    b.level = 9;
+    CHECK(PackCache::optionsKey(&b, "a.out") != k);
+    b.level = a.level;
+    b.crp.crp_lzma.dict_size = 1024 * 1024;
+    CHECK(PackCache::optionsKey(&b, "a.out") != k);
+    CHECK(PackCache::optionsKey(&a, "a.com") != k);
+}
+
+TEST_CASE("PackCache classify_name") {
+    const char *h48 = "0123456789abcdef0123456789abcdef0123456789abcdef";
+    char name[128];
+    upx_safe_snprintf(name, sizeof(name), "%s-0123456789abcdef.upx", h48);
+    CHECK(classify_name(name) == NAME_ENTRY);
+    upx_safe_snprintf(name, sizeof(name), "%s.hint", h48);
+    CHECK(classify_name(name) == NAME_ENTRY);
+    upx_safe_snprintf(name, sizeof(name), "%s-0123456789abcdef.1234.tmp", h48);
+    CHECK(classify_name(name) == NAME_TMP);
+    upx_safe_snprintf(name, sizeof(name), "%s.0.tmp", h48);
+    CHECK(classify_name(name) == NAME_TMP);
+    // anything else is not ours
+    CHECK(classify_name("a.upx") == NAME_OTHER);
+    CHECK(classify_name("README.hint") == NAME_OTHER);
+    upx_safe_snprintf(name, sizeof(name), "%s.upx", h48); // no options key
+    CHECK(classify_name(name) == NAME_OTHER);
+    upx_safe_snprintf(name, sizeof(name), "%s-0123456789abcdef.hint", h48);
+    CHECK(classify_name(name) == NAME_OTHER);
+    upx_safe_snprintf(name, sizeof(name), "%s-0123456789ABCDEF.upx", h48);
+    CHECK(classify_name(name) == NAME_OTHER);
+    upx_safe_snprintf(name, sizeof(name), "%s-0123456789abcdef.upx.bak", h48);
+    CHECK(classify_name(name) == NAME_OTHER);
+    upx_safe_snprintf(name, sizeof(name), "%s-0123456789abcdef.upx", h48 + 1);
+    CHECK(classify_name(name) == NAME_OTHER);
+    upx_safe_snprintf(name, sizeof(name), "%s..tmp", h48);
+    CHECK(classify_name(name) == NAME_OTHER);
+    upx_safe_snprintf(name, sizeof(name), "%s.12x.tmp", h48);
+    CHECK(classify_name(name) == NAME_OTHER);
+}
+
+#if HAVE_DIRENT_H && HAVE_UTIME
+
+static void write_test_file(const char *name, const byte *data, unsigned len,
+                            time_t mtime = 0) {
+    OutputFile fo;
+    fo.open(name, O_WRONLY | O_CREAT | O_TRUNC | O_BINARY, 0600);
+    fo.write(data, len);
+    fo.closex();
+    if (mtime != 0) {
+        struct utimbuf ut;
+        ut.actime = ut.modtime = mtime;
+        (void) utime(name, &ut);
+    }
+}
+
+static bool test_file_exists(const char *name) {
+    struct stat st = {};
+    return stat(name, &st) == 0;
+}
+
+TEST_CASE("PackCache fetch store evict") {
+    char dir[64], path[ACC_FN_PATH_MAX + 1], in_name[ACC_FN_PATH_MAX + 1];
+    char packed_name[ACC_FN_PATH_MAX + 1], out_name[ACC_FN_PATH_MAX + 1];
+    upx_safe_snprintf(dir, sizeof(dir), "upx-doctest-cache-%u", (unsigned) getpid());
+    (void) acc_mkdir(dir, 0777);
+    upx_safe_snprintf(in_name, sizeof(in_name), "%s.in", dir);
+    upx_safe_snprintf(packed_name, sizeof(packed_name), "%s.packed", dir);
+    upx_safe_snprintf(out_name, sizeof(out_name), "%s.out", dir);
+    const int saved_verbose = opt->verbose;
+    const unsigned saved_cache_size = opt->cache_size;
+    opt->verbose = -1; // no "[cached]" line
+    opt->cache_size = 1; // MiB
+
+    // the input file, and a packed file with a PackHeader in the trailer
+    MemBuffer data(600 * 1024);
+    for (unsigned i = 0; i < data.getSize(); i++)
+        data[i] = byte(i * 7 + (i >> 9));
+    write_test_file(in_name, data, 5000);
+    {
+        MemBuffer packed(8192 + 32 + 4);
+        memcpy(packed, data, 8192);
+        byte *p = packed + 8192;
+        memset(p, 0, 32 + 4);
+        set_le32(p, UPX_MAGIC_LE32);
+        set_le32(p + 4, UPX_MAGIC2_LE32);
+        PackHeader ph;
+        ph.version = 13;
+        ph.format = UPX_F_LINUX_ELF64_AMD64;
+        ph.method = M_NRV2B_LE32;
+        ph.level = 8;
+        ph.u_len = 5000;
+        ph.c_len = 4000;
+        ph.u_file_size = 5000;
+        ph.filter = 0x49;
+        ph.putPackHeader(SPAN_S_MAKE(byte, p, 32));
+        set_le32(p + 32, 0x1234); // overlay_offset
+        write_test_file(packed_name, packed, packed.getSize());
+    }
+
+    // files in the cache directory which are not ours, or not old enough
+    const char *h48 = "0123456789abcdef0123456789abcdef0123456789abcdef";
+    const time_t now = time(nullptr);
+    static const char *const foreign[] = {
+        "README", "notes.upx", "0123456789ABCDEF0123456789ABCDEF0123456789ABCDEF.hint",
+        "0123456789abcdef0123456789abcdef0123456789abcdef-0123456789abcdef.upx.orig"};
+    for (size_t i = 0; i < TABLESIZE(foreign); i++) {
+        upx_safe_snprintf(path, sizeof(path), "%s/%s", dir, foreign[i]);
+        write_test_file(path, data, data.getSize(), now - 3 * 86400); // old and big
+    }
+    upx_safe_snprintf(path, sizeof(path), "%s/%s.1.tmp", dir, h48);
+    write_test_file(path, data, 100, now - 2 * 3600); // stale
+    upx_safe_snprintf(path, sizeof(path), "%s/%s.2.tmp", dir, h48);
+    write_test_file(path, data, 100); // maybe still being written
+    // two old entries of 600 KiB; only the oldest one must go
+    upx_safe_snprintf(path, sizeof(path), "%s/%s-aaaaaaaaaaaaaaaa.upx", dir, h48);
+    write_test_file(path, data, data.getSize(), now - 2 * 86400);
+    upx_safe_snprintf(path, sizeof(path), "%s/%s-bbbbbbbbbbbbbbbb.upx", dir, h48);
+    write_test_file(path, data, data.getSize(), now - 86400);
+
+    InputFile fi;
+    fi.open(in_name, O_RDONLY | O_BINARY);
+    {
+        // miss, then store
+        PackCache cache;
+        cache.open(dir, &fi, in_name);
+        CHECK(cache.isOpen());
+        int method = 0, filter = 0;
+        CHECK(!cache.getHint(&method, &filter));
+        OutputFile fo;
+        fo.open(out_name, O_WRONLY | O_CREAT | O_TRUNC | O_BINARY, 0600);
+        CHECK(!cache.fetch(&fo));
+        fo.closex();
+        cache.store(packed_name);
+    }
+    {
+        // hit
+        PackCache cache;
+        cache.open(dir, &fi, in_name);
+        int method = 0, filter = 0;
+        CHECK(cache.getHint(&method, &filter));
+        CHECK(method == M_NRV2B_LE32);
+        CHECK(filter == 0x49);
+        OutputFile fo;
+        fo.open(out_name, O_WRONLY | O_CREAT | O_TRUNC | O_BINARY, 0600);
+        CHECK(cache.fetch(&fo));
+        CHECK(fo.getBytesWritten() == 8192 + 32 + 4);
+        fo.closex();
+    }
+    fi.closex();
+
+    // evict() kept the foreign files and the fresh temporary file
+    for (size_t i = 0; i < TABLESIZE(foreign); i++) {
+        upx_safe_snprintf(path, sizeof(path), "%s/%s", dir, foreign[i]);
+        CHECK(test_file_exists(path));
+        (void) FileBase::unlink_noexcept(path);
+    }
+    upx_safe_snprintf(path, sizeof(path), "%s/%s.1.tmp", dir, h48);
+    CHECK(!test_file_exists(path));
+    upx_safe_snprintf(path, sizeof(path), "%s/%s.2.tmp", dir, h48);
+    CHECK(test_file_exists(path));
+    (void) FileBase::unlink_noexcept(path);
+    upx_safe_snprintf(path, sizeof(path), "%s/%s-aaaaaaaaaaaaaaaa.upx", dir, h48);
+    CHECK(!test_file_exists(path));
+    upx_safe_snprintf(path, sizeof(path), "%s/%s-bbbbbbbbbbbbbbbb.upx", dir, h48);
+    CHECK(test_file_exists(path));
+    (void) FileBase::unlink_noexcept(path);
+
+    // clean up the new entry and its hint
+    DIR *d = opendir(dir);
+    CHECK(d != nullptr);
+    unsigned nentries = 0;
+    while (d != nullptr) {
+        const struct dirent *e = readdir(d);
+        if (e == nullptr)
+            break;
+        if (classify_name(e->d_name) == NAME_ENTRY) {
+            nentries += 1;
+            upx_safe_snprintf(path, sizeof(path), "%s/%s", dir, e->d_name);
+            (void) FileBase::unlink_noexcept(path);
+        }
+    }
+    if (d != nullptr)
+        closedir(d);
+    CHECK(nentries == 2); // .upx and .hint
+    CHECK(acc_rmdir(dir) == 0);
+    (void) FileBase::unlink_noexcept(in_name);
+    (void) FileBase::unlink_noexcept(packed_name);
+    (void) FileBase::unlink_noexcept(out_name);
+    opt->verbose = saved_verbose;
+    opt->cache_size = saved_cache_size;
+}
+
+#endif // HAVE_DIRENT_H && HAVE_UTIME
+
+/* vim:set ts=4 sw=4 et: */
@@ -0,0 +1,76 @@
+/* packcache.h -- persistent cache of packed files
+
+   This file is part of the UPX executable compressor.
+
+   Copyright (C) 1996-2024 Markus Franz Xaver Johannes Oberhumer
+   Copyright (C) 1996-2024 Laszlo Molnar
+   All Rights Reserved.
+
+   UPX and the UCL library are free software; you can redistribute them
+   and/or modify them under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of
+   the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; see the file COPYING.
+   If not, write to the Free Software Foundation, Inc.,
+   59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+
+   Markus F.X.J. Oberhumer              Laszlo Molnar
+   <markus@oberhumer.com>               <ezerotven+github@gmail.com>
+ */
+
+#pragma once
+
+class InputFile;
+class OutputFile;
+
+/*************************************************************************
+// option "--cache-dir": a content-addressed cache of packed files
+//
+// DIR/<contents>-<options>.upx  packed file for these contents and options
+// DIR/<contents>.hint           winning method and filter of the last packing
+//                               of these contents, with any options
+//
+// The keys are checksums, not cryptographic hashes, so the cache
+// directory must only be writable by trusted users.
+// Entries are written to a temporary file and then renamed, so concurrent
+// runs never see partial entries; the least recently used entries are
+// removed when the cache grows beyond "--cache-size". Files with other
+// names in DIR are never removed.
+**************************************************************************/
+
+class PackCache final {
+public:
+    explicit PackCache() noexcept = default;
+
+    // hash the contents of fi and the current options; rewinds fi
+    void open(const char *dir, InputFile *fi, const char *iname) may_throw;
+    bool isOpen() const noexcept { return full_key[0] != 0; }
+
+    // on a hit copy the stored packed file to fo and print the usual line
+    bool fetch(OutputFile *fo) may_throw;
+    // the method and filter which won for the same contents before
+    bool getHint(int *method, int *filter) const noexcept;
+    // add the packed file "packed_name"; errors are ignored
+    void store(const char *packed_name) noexcept;
+
+    static upx_uint64_t optionsKey(const Options *o, const char *iname) noexcept;
+
+private:
+    void makePath(char *path, const char *key, const char *ext) const may_throw;
+    void evict() const may_throw;
+
+    const char *iname = nullptr;
+    char dir[ACC_FN_PATH_MAX + 1] = {};
+    char content_key[48 + 1] = {}; // size and checksums of the contents
+    char full_key[48 + 1 + 16 + 1] = {};
+    char entry_path[ACC_FN_PATH_MAX + 1] = {}; // FileBase only keeps a pointer to the name
+};
+
+/* vim:set ts=4 sw=4 et: */
@@ -26,6 +26,7 @@
  */
 
 #include "conf.h"
+#include "compress/compress.h" // upx_lzma_autotune()
 #include "file.h"
 #include "packer.h"
 #include "filter.h"
@@ -150,19 +151,26 @@ bool Packer::testUnpackFormat(int format) const {
 
 bool Packer::compress(SPAN_P(byte) i_ptr, unsigned i_len, SPAN_P(byte) o_ptr,
                       const upx_compress_config_t *cconf_parm) {
-    ph.u_len = i_len;
-    ph.c_len = 0;
-    assert(ph.level >= 1);
-    assert(ph.level <= 10);
+    return compress(ph, i_ptr, i_len, o_ptr, cconf_parm, uip);
+}
+
+// does not touch any Packer state except through "cph" and "ui", so it may be
+// called from worker threads when ui == nullptr
+bool Packer::compress(PackHeader &cph, SPAN_P(byte) i_ptr, unsigned i_len, SPAN_P(byte) o_ptr,
+                      const upx_compress_config_t *cconf_parm, UiPacker *ui) const {
+    cph.u_len = i_len;
+    cph.c_len = 0;
+    assert(cph.level >= 1);
+    assert(cph.level <= 10);
 
     // Avoid too many progress bar updates. 64 is s->bar_len in ui.cpp.
-    unsigned step = (ph.u_len < 64 * 1024) ? 0 : ph.u_len / 64;
+    unsigned step = (cph.u_len < 64 * 1024) ? 0 : cph.u_len / 64;
 
     // save current checksums
-    ph.saved_u_adler = ph.u_adler;
-    ph.saved_c_adler = ph.c_adler;
+    cph.saved_u_adler = cph.u_adler;
+    cph.saved_c_adler = cph.c_adler;
     // update checksum of uncompressed data
-    ph.u_adler = upx_adler32(raw_bytes(i_ptr, ph.u_len), ph.u_len, ph.u_adler);
+    cph.u_adler = upx_adler32(raw_bytes(i_ptr, cph.u_len), cph.u_len, cph.u_adler);
 
     // set compression parameters
     upx_compress_config_t cconf;
@@ -170,7 +178,7 @@ bool Packer::compress(SPAN_P(byte) i_ptr, unsigned i_len, SPAN_P(byte) o_ptr,
     if (cconf_parm)
         cconf = *cconf_parm;
     // cconf options
-    int method = ph_forced_method(ph.method);
+    int method = ph_forced_method(cph.method);
     if (M_IS_NRV2B(method) || M_IS_NRV2D(method) || M_IS_NRV2E(method)) {
         if (opt->crp.crp_ucl.c_flags != -1)
             cconf.conf_ucl.c_flags = opt->crp.crp_ucl.c_flags;
@@ -185,7 +193,7 @@ bool Packer::compress(SPAN_P(byte) i_ptr, unsigned i_len, SPAN_P(byte) o_ptr,
             opt->crp.crp_ucl.max_match < cconf.conf_ucl.max_match)
             cconf.conf_ucl.max_match = opt->crp.crp_ucl.max_match;
 #if (WITH_NRV)
-        if ((ph.level >= 7 || (ph.level >= 4 && ph.u_len >= 512 * 1024)) && !opt->prefer_ucl)
+        if ((cph.level >= 7 || (cph.level >= 4 && cph.u_len >= 512 * 1024)) && !opt->prefer_ucl)
             step = 0;
 #endif
     }
@@ -194,26 +202,35 @@ bool Packer::compress(SPAN_P(byte) i_ptr, unsigned i_len, SPAN_P(byte) o_ptr,
         oassign(cconf.conf_lzma.lit_pos_bits, opt->crp.crp_lzma.lit_pos_bits);
         oassign(cconf.conf_lzma.lit_context_bits, opt->crp.crp_lzma.lit_context_bits);
         oassign(cconf.conf_lzma.dict_size, opt->crp.crp_lzma.dict_size);
+        oassign(cconf.conf_lzma.fast_mode, opt->crp.crp_lzma.fast_mode);
         oassign(cconf.conf_lzma.num_fast_bytes, opt->crp.crp_lzma.num_fast_bytes);
+        oassign(cconf.conf_lzma.match_finder_cycles, opt->crp.crp_lzma.match_finder_cycles);
+        if (opt->crp.crp_lzma.autotune)
+            cconf.conf_lzma.autotune = true;
+        cconf.conf_lzma.abort_on_time_budget = opt->time_budget_hard;
     }
     if (M_IS_DEFLATE(method)) {
         oassign(cconf.conf_zlib.mem_level, opt->crp.crp_zlib.mem_level);
         oassign(cconf.conf_zlib.window_bits, opt->crp.crp_zlib.window_bits);
         oassign(cconf.conf_zlib.strategy, opt->crp.crp_zlib.strategy);
     }
-    if (uip->ui_pass >= 0)
-        uip->ui_pass++;
-    uip->startCallback(ph.u_len, step, uip->ui_pass, uip->ui_total_passes);
-    uip->firstCallback();
+    if (ui != nullptr) {
+        if (ui->ui_pass >= 0)
+            ui->ui_pass++;
+        ui->startCallback(cph.u_len, step, ui->ui_pass, ui->ui_total_passes);
+        ui->firstCallback();
+    }
 
-    // OutputFile::dump("data.raw", in, ph.u_len);
+    // OutputFile::dump("data.raw", in, cph.u_len);
 
     // compress
-    int r = upx_compress(raw_bytes(i_ptr, ph.u_len), ph.u_len, raw_bytes(o_ptr, 0), &ph.c_len,
-                         uip->getCallback(), method, ph.level, &cconf, &ph.compress_result);
+    upx_callback_t *const cb = ui != nullptr ? ui->getCallback() : nullptr;
+    int r = upx_compress(raw_bytes(i_ptr, cph.u_len), cph.u_len, raw_bytes(o_ptr, 0), &cph.c_len,
+                         cb, method, cph.level, &cconf, &cph.compress_result);
 
-    // uip->finalCallback(ph.u_len, ph.c_len);
-    uip->endCallback();
+    // ui->finalCallback(cph.u_len, cph.c_len);
+    if (ui != nullptr)
+        ui->endCallback();
 
     if (r == UPX_E_OUT_OF_MEMORY)
         throwOutOfMemoryException();
@@ -221,47 +238,48 @@ bool Packer::compress(SPAN_P(byte) i_ptr, unsigned i_len, SPAN_P(byte) o_ptr,
         throwInternalError("compression failed");
 
     if (M_IS_NRV2B(method) || M_IS_NRV2D(method) || M_IS_NRV2E(method)) {
-        const ucl_uint *res = ph.compress_result.result_ucl.result;
-        // ph.min_offset_found = res[0];
-        ph.max_offset_found = res[1];
-        // ph.min_match_found = res[2];
-        ph.max_match_found = res[3];
-        // ph.min_run_found = res[4];
-        ph.max_run_found = res[5];
-        ph.first_offset_found = res[6];
-        // ph.same_match_offsets_found = res[7];
+        const ucl_uint *res = cph.compress_result.result_ucl.result;
+        // cph.min_offset_found = res[0];
+        cph.max_offset_found = res[1];
+        // cph.min_match_found = res[2];
+        cph.max_match_found = res[3];
+        // cph.min_run_found = res[4];
+        cph.max_run_found = res[5];
+        cph.first_offset_found = res[6];
+        // cph.same_match_offsets_found = res[7];
         if (cconf_parm) {
             assert(cconf.conf_ucl.max_offset == 0 ||
-                   cconf.conf_ucl.max_offset >= ph.max_offset_found);
-            assert(cconf.conf_ucl.max_match == 0 || cconf.conf_ucl.max_match >= ph.max_match_found);
+                   cconf.conf_ucl.max_offset >= cph.max_offset_found);
+            assert(cconf.conf_ucl.max_match == 0 ||
+                   cconf.conf_ucl.max_match >= cph.max_match_found);
         }
     }
 
-    NO_printf("\nPacker::compress: %d/%d: %7d -> %7d\n", method, ph.level, ph.u_len, ph.c_len);
-    if (!checkCompressionRatio(ph.u_len, ph.c_len))
+    NO_printf("\nPacker::compress: %d/%d: %7d -> %7d\n", method, cph.level, cph.u_len, cph.c_len);
+    if (!checkCompressionRatio(cph.u_len, cph.c_len))
         return false;
     // return in any case if not compressible
-    if (ph.c_len >= ph.u_len)
+    if (cph.c_len >= cph.u_len)
         return false;
 
     // update checksum of compressed data
-    ph.c_adler = upx_adler32(raw_bytes(o_ptr, ph.c_len), ph.c_len, ph.c_adler);
+    cph.c_adler = upx_adler32(raw_bytes(o_ptr, cph.c_len), cph.c_len, cph.c_adler);
     // Decompress and verify. Skip this when using the fastest level.
-    if (!ph_skipVerify(ph)) {
+    if (!ph_skipVerify(cph)) {
         // decompress
-        unsigned new_len = ph.u_len;
-        r = upx_decompress(raw_bytes(o_ptr, ph.c_len), ph.c_len, raw_bytes(i_ptr, ph.u_len),
-                           &new_len, method, &ph.compress_result);
+        unsigned new_len = cph.u_len;
+        r = upx_decompress(raw_bytes(o_ptr, cph.c_len), cph.c_len, raw_bytes(i_ptr, cph.u_len),
+                           &new_len, method, &cph.compress_result);
         if (r == UPX_E_OUT_OF_MEMORY)
             throwOutOfMemoryException();
-        // printf("%d %d: %d %d %d\n", method, r, ph.c_len, ph.u_len, new_len);
+        // printf("%d %d: %d %d %d\n", method, r, cph.c_len, cph.u_len, new_len);
         if (r != UPX_E_OK)
             throwInternalError("decompression failed");
-        if (new_len != ph.u_len)
+        if (new_len != cph.u_len)
             throwInternalError("decompression failed (size error)");
 
         // verify decompression
-        if (ph.u_adler != upx_adler32(raw_bytes(i_ptr, ph.u_len), ph.u_len, ph.saved_u_adler))
+        if (cph.u_adler != upx_adler32(raw_bytes(i_ptr, cph.u_len), cph.u_len, cph.saved_u_adler))
             throwInternalError("decompression failed (checksum error)");
     }
     return true;
@@ -307,9 +325,9 @@ void Packer::decompress(SPAN_P(const byte) in, SPAN_P(byte) out, bool verify_che
 // overlapping decompression
 **************************************************************************/
 
-bool Packer::testOverlappingDecompression(const byte *buf, const byte *tbuf,
-                                          unsigned overlap_overhead) const {
-    return ph_testOverlappingDecompression(ph, buf, tbuf, overlap_overhead);
+bool Packer::testOverlappingDecompression(const PackHeader &oph, const byte *buf,
+                                          const byte *tbuf, unsigned overlap_overhead) const {
+    return ph_testOverlappingDecompression(oph, buf, tbuf, overlap_overhead);
 }
 
 void Packer::verifyOverlappingDecompression(Filter *ft) {
@@ -362,13 +380,13 @@ void Packer::verifyOverlappingDecompression(byte *o_ptr, unsigned o_size, Filter
 //   - you can enforce an upper_limit (so that we can fail early)
 **************************************************************************/
 
-unsigned Packer::findOverlapOverhead(const byte *buf, const byte *tbuf, unsigned range,
-                                     unsigned upper_limit) const {
+unsigned Packer::findOverlapOverhead(const PackHeader &oph, const byte *buf, const byte *tbuf,
+                                     unsigned range, unsigned upper_limit) const {
     assert((int) range >= 0);
 
     // prepare to deal with very pessimistic values
     unsigned low = 1;
-    unsigned high = UPX_MIN(ph.u_len + 512, upper_limit);
+    unsigned high = UPX_MIN(oph.u_len + 512, upper_limit);
     // but be optimistic for first try (speedup)
     unsigned m = UPX_MIN(16u, high);
     //
@@ -376,11 +394,12 @@ unsigned Packer::findOverlapOverhead(const byte *buf, const byte *tbuf, unsigned
     unsigned nr = 0; // statistics
 
     while (high >= low) {
+        upx_time_budget_check();
         assert(m >= low);
         assert(m <= high);
         assert(m < overhead || overhead == 0);
         nr++;
-        bool success = testOverlappingDecompression(buf, tbuf, m);
+        bool success = testOverlappingDecompression(oph, buf, tbuf, m);
         // printf("testOverlapOverhead(%d): %d %d: %d -> %d\n", nr, low, high, m, (int)success);
         if (success) {
             overhead = m;
@@ -390,6 +409,8 @@ unsigned Packer::findOverlapOverhead(const byte *buf, const byte *tbuf, unsigned
             //   if (m <  low + range)
             if (m - low < range) // avoid underflow
                 break;
+            if (upx_time_budget_expired()) // a larger overhead is still valid
+                break;
             high = m - 1;
         } else
             low = m + 1;
@@ -1062,6 +1083,56 @@ void Packer::compressWithFilters(byte *i_ptr,
     int nfilters = prepareFilters(filters, filter_strategy, getFilters());
     assert(nfilters > 0);
     assert(nfilters < 256);
+    // Try the method and filter of a hint first (see class PackCache), so that
+    // the worse trials after it can skip findOverlapOverhead(). Ties are broken
+    // by the original position, so the result does not depend on the order.
+    int method_rank[256], filter_rank[256];
+    for (int i = 0; i < nmethods; i++)
+        method_rank[i] = i;
+    for (int i = 0; i < nfilters; i++)
+        filter_rank[i] = i;
+    auto move_to_front = [](int *v, int *rank, int n, int value) {
+        for (int i = 1; i < n; i++) {
+            if (v[i] == value) {
+                const int r = rank[i];
+                memmove(v + 1, v, sizeof(*v) * i);
+                memmove(rank + 1, rank, sizeof(*rank) * i);
+                v[0] = value;
+                rank[0] = r;
+                break;
+            }
+        }
+    };
+    if (opt->hint_method != 0) {
+        move_to_front(methods, method_rank, nmethods, opt->hint_method);
+        if (filter_strategy >= 0) // else the first filter that works is used
+            move_to_front(filters, filter_rank, nfilters, opt->hint_filter);
+    }
+    unsigned best_rank = 0;
+    // --lzma-autotune: choose pb/lp/lc once for this block, on the unfiltered
+    // data, instead of sampling again in every trial; methods which encode
+    // pb/lp/lc themselves (M_LZMA_003 etc.) keep the plain cconf
+    upx_compress_config_t lzma_cconf;
+    bool use_lzma_cconf = false;
+#if (WITH_LZMA)
+    if (opt->crp.crp_lzma.autotune && !opt->crp.crp_lzma.pos_bits.is_set &&
+        !opt->crp.crp_lzma.lit_pos_bits.is_set && !opt->crp.crp_lzma.lit_context_bits.is_set) {
+        for (int mm = 0; mm < nmethods; mm++)
+            if (ph_forced_method(methods[mm]) == M_LZMA)
+                use_lzma_cconf = true;
+        if (use_lzma_cconf) {
+            lzma_cconf.reset();
+            if (cconf)
+                lzma_cconf = *cconf;
+            upx_lzma_autotune(i_ptr, i_len, &lzma_cconf.conf_lzma);
+            lzma_cconf.conf_lzma.autotune = false;
+            use_lzma_cconf = lzma_cconf.conf_lzma.pos_bits.is_set;
+        }
+    }
+#endif
+    auto trial_cconf = [&](int method) {
+        return (use_lzma_cconf && ph_forced_method(method) == M_LZMA) ? &lzma_cconf : cconf;
+    };
 #if 0
     printf("compressWithFilters: m(%d):", nmethods);
     for (int i = 0; i < nmethods; i++)
@@ -1086,9 +1157,102 @@ void Packer::compressWithFilters(byte *i_ptr,
     byte *o_tmp = o_ptr;
     MemBuffer o_tmp_buf;
 
+    // Parallel trials: with several threads and several trials, the trials
+    // are compressed ahead in batches, each one on its own filtered copy of
+    // the input. The loop below still filters i_ptr[] in place and then picks
+    // up the prepared result, so the loader sizes and the choice of the best
+    // trial are exactly the same as in a serial run. As in a serial run,
+    // findOverlapOverhead() is only called for the trials which can still win.
+    struct Trial {
+        int mm, ff;
+        bool success;
+        PackHeader ph;
+        MemBuffer ibuf; // copy of [copy_ptr, i_ptr + i_len)
+        MemBuffer obuf;
+    };
+    Trial trials[64];
+    Array(int, trial_list, nmethods * nfilters); // mm * 256 + ff, in loop order
+    unsigned ntrials = 0, max_batch = 0, trials_done = 0, batch_first = 0, batch_size = 0;
+    byte *const copy_ptr = UPX_MIN(i_ptr, f_ptr);
+    const unsigned copy_len = ptr_udiff_bytes(i_ptr + i_len, copy_ptr);
+    {
+        max_batch = UPX_MIN(upx_get_num_threads(), (unsigned) TABLESIZE(trials));
+        // limit the extra memory of a batch to 1 GiB, or to half of --max-memory;
+        // split between concurrent packers, e.g. the slices of a fat Mach-O file
+        upx_uint64_t batch_limit = 1024 * 1024 * 1024;
+        if (upx_get_max_memory() != 0)
+            batch_limit = UPX_MIN(batch_limit, upx_get_max_memory() / 2);
+        batch_limit /= upx_get_num_sharing();
+        const upx_uint64_t slot_size =
+            copy_len + (upx_uint64_t) MemBuffer::getSizeForCompression(i_len);
+        while (max_batch > 1 && max_batch * slot_size > batch_limit)
+            max_batch--;
+        if (max_batch > 1 && (nmethods > 1 || (nfilters > 1 && filter_strategy >= 0))) {
+            // list the trials the loop will compress; whether a filter
+            // succeeds does not depend on the method, so probe each one once
+            signed char filter_ok[256];
+            memset(filter_ok, -1, sizeof(filter_ok));
+            for (int mm = 0; mm < nmethods; mm++) {
+                for (int ff = 0; ff < nfilters; ff++) {
+                    if (filter_ok[ff] < 0) {
+                        Filter ft = orig_ft;
+                        ft.init(filters[ff], orig_ft.addvalue);
+                        optimizeFilter(&ft, f_ptr, f_len);
+                        bool success = ft.filter(f_ptr, f_len);
+                        if (ft.id != 0 && ft.calls == 0)
+                            success = false;
+                        else if (success)
+                            ft.unfilter(f_ptr, f_len, true);
+                        filter_ok[ff] = success ? 1 : 0;
+                    }
+                    if (!filter_ok[ff])
+                        continue;
+                    trial_list[ntrials++] = mm * 256 + ff;
+                    if (filter_strategy < 0)
+                        break;
+                }
+            }
+            if (ntrials < 2)
+                ntrials = 0; // nothing to gain
+        }
+    }
+    auto compress_batch = [&]() {
+        batch_first = trials_done;
+        batch_size = UPX_MIN(max_batch, ntrials - trials_done);
+        for (unsigned i = 0; i < batch_size; i++) {
+            Trial &t = trials[i];
+            t.mm = trial_list[batch_first + i] / 256;
+            t.ff = trial_list[batch_first + i] % 256;
+            if (t.ibuf.getSize() == 0) {
+                t.ibuf.alloc(copy_len);
+                t.obuf.allocForCompression(i_len);
+            }
+        }
+        upx_parallel_for(batch_size, [&](size_t i) {
+            Trial &t = trials[i];
+            memcpy(t.ibuf, copy_ptr, copy_len);
+            byte *const t_i_ptr = t.ibuf + ptr_udiff_bytes(i_ptr, copy_ptr);
+            byte *const t_f_ptr = t.ibuf + ptr_udiff_bytes(f_ptr, copy_ptr);
+            byte *const t_o_ptr = t.obuf;
+            Filter ft = orig_ft;
+            ft.init(filters[t.ff], orig_ft.addvalue);
+            optimizeFilter(&ft, t_f_ptr, f_len);
+            if (!ft.filter(t_f_ptr, f_len))
+                throwInternalError("parallel trial filter failed");
+            t.ph = orig_ph;
+            t.ph.method = methods[t.mm];
+            t.ph.filter = filters[t.ff];
+            t.ph.overlap_overhead = 0;
+            t.ph.filter_cto = ft.cto;
+            t.ph.n_mru = ft.n_mru;
+            t.success = compress(t.ph, t_i_ptr, i_len, t_o_ptr, trial_cconf(t.ph.method), nullptr);
+        });
+    };
+
     // compress using all methods/filters
     int nfilters_success_total = 0;
-    for (int mm = 0; mm < nmethods; mm++) // for all methods
+    bool out_of_time = false; // see option "--time-budget="
+    for (int mm = 0; mm < nmethods && !out_of_time; mm++) // for all methods
     {
         NO_printf("\nmethod %d (%d of %d)\n", methods[mm], 1 + mm, nmethods);
         assert(isValidCompressionMethod(methods[mm]));
@@ -1110,6 +1274,14 @@ void Packer::compressWithFilters(byte *i_ptr,
         for (int ff = 0; ff < nfilters; ff++) // for all filters
         {
             assert(isValidFilter(filters[ff]));
+            // when the time is up keep the best valid result so far
+            upx_time_budget_check();
+            if (best_ph.overlap_overhead > 0 && upx_time_budget_expired()) {
+                out_of_time = true;
+                break;
+            }
+            if (trials_done < ntrials && trials_done == batch_first + batch_size)
+                compress_batch(); // i_ptr[] is not filtered right now
             // get fresh packheader
             ph = orig_ph;
             ph.method = methods[mm];
@@ -1138,7 +1310,14 @@ void Packer::compressWithFilters(byte *i_ptr,
             NO_printf("\nfilter: id 0x%02x size %6d, calls %5d/%5d/%3d/%5d/%5d, cto 0x%02x\n",
                       ft.id, ft.buf_len, ft.calls, ft.noncalls, ft.wrongcalls, ft.firstcall,
                       ft.lastcall, ft.cto);
-            if (nfilters_success_total != 0 && o_tmp == o_ptr) {
+            const Trial *trial = nullptr;
+            if (trials_done < ntrials) {
+                trial = &trials[trials_done - batch_first];
+                assert(trial->mm == mm && trial->ff == ff);
+                assert(trial->ph.filter_cto == ft.cto);
+                trials_done++;
+            }
+            if (trial == nullptr && nfilters_success_total != 0 && o_tmp == o_ptr) {
                 o_tmp_buf.allocForCompression(i_len);
                 o_tmp = o_tmp_buf;
             }
@@ -1147,15 +1326,26 @@ void Packer::compressWithFilters(byte *i_ptr,
             ph.filter_cto = ft.cto;
             ph.n_mru = ft.n_mru;
             // compress
-            if (compress(i_ptr, i_len, o_tmp, cconf)) {
+            byte *o_trial = o_tmp;
+            bool compressed;
+            if (trial != nullptr) {
+                // already compressed by compress_batch()
+                ph = trial->ph;
+                o_trial = trial->obuf;
+                compressed = trial->success;
+                if (uip->ui_pass >= 0)
+                    uip->ui_pass++;
+            } else
+                compressed = compress(i_ptr, i_len, o_tmp, trial_cconf(ph.method));
+            if (compressed) {
+                const unsigned trial_rank = method_rank[mm] * 256 + filter_rank[ff];
                 unsigned lsize = 0;
                 // findOverlapOperhead() might be slow; omit if already too big.
                 if (ph.c_len + lsize + hdr_c_len <=
                     best_ph.c_len + best_ph_lsize + best_hdr_c_len) {
-                    // get results
-                    ph.overlap_overhead = findOverlapOverhead(o_tmp, i_ptr, overlap_range);
-                    buildLoader(&ft);
-                    lsize = getLoaderSize();
+                    // get results; i_ptr[] is filtered just like the copy of the trial
+                    ph.overlap_overhead = findOverlapOverhead(ph, o_trial, i_ptr, overlap_range);
+                    lsize = getTrialLoaderSize(&ft);
                     assert(lsize > 0);
                 }
                 NO_printf("\n%2d %02x: %d +%4d +%3d = %d  (best: %d +%4d +%3d = %d)\n", ph.method,
@@ -1174,18 +1364,22 @@ void Packer::compressWithFilters(byte *i_ptr,
                         // prefer less overlap_overhead
                         if (ph.overlap_overhead < best_ph.overlap_overhead)
                             update = true;
+                        else if (ph.overlap_overhead == best_ph.overlap_overhead &&
+                                 trial_rank < best_rank)
+                            update = true; // see hint_method above
                     }
                 }
                 if (update) {
                     assert((int) ph.overlap_overhead > 0);
                     // update o_ptr[] with best version
-                    if (o_tmp != o_ptr)
-                        memcpy(o_ptr, o_tmp, ph.c_len);
+                    if (o_trial != o_ptr)
+                        memcpy(o_ptr, o_trial, ph.c_len);
                     // save compression results
                     best_ph = ph;
                     best_ph_lsize = lsize;
                     best_hdr_c_len = hdr_c_len;
                     best_ft = ft;
+                    best_rank = trial_rank;
                 }
             }
             // restore - unfilter with verify
@@ -1193,7 +1387,7 @@ void Packer::compressWithFilters(byte *i_ptr,
             if (filter_strategy < 0)
                 break;
         }
-        assert(nfilters_success_mm > 0);
+        assert(nfilters_success_mm > 0 || out_of_time);
     }
 
     // postconditions 1)
@@ -1223,6 +1417,38 @@ void Packer::compressWithFilters(byte *i_ptr,
     buildLoader(&best_ft);
 }
 
+/*************************************************************************
+// Building the loader (which may include compressing the stub) is done
+// for every trial of compressWithFilters(); for multi-block formats this
+// means several hundred identical builds. Packers whose loader size does
+// not depend on the compressed data opt in via getLoaderSizeKey().
+// The final buildLoader(&best_ft) is always done for real.
+**************************************************************************/
+
+unsigned Packer::getTrialLoaderSize(const Filter *ft) {
+    unsigned extra = 0;
+    if (!getLoaderSizeKey(&extra)) {
+        buildLoader(ft);
+        return getLoaderSize();
+    }
+    const unsigned n = UPX_MIN(loader_size_memo_count, (unsigned) TABLESIZE(loader_size_memo));
+    for (unsigned i = 0; i < n; i++) {
+        const LoaderSizeMemo &m = loader_size_memo[i];
+        if (m.method == ph.method && m.filter == ft->id && m.cto == ft->cto &&
+            m.n_mru == ft->n_mru && m.extra == extra)
+            return m.lsize;
+    }
+    buildLoader(ft);
+    LoaderSizeMemo &m = loader_size_memo[loader_size_memo_count++ % TABLESIZE(loader_size_memo)];
+    m.method = ph.method;
+    m.filter = ft->id;
+    m.cto = ft->cto;
+    m.n_mru = ft->n_mru;
+    m.extra = extra;
+    m.lsize = getLoaderSize();
+    return m.lsize;
+}
+
 /*************************************************************************
 //
 **************************************************************************/
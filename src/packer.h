@@ -42,6 +42,7 @@ class Filter;
 **************************************************************************/
 
 class PackerBase {
+    friend class PackMaster; // listHeaderOnly()
     friend class UiPacker;
 protected:
     explicit PackerBase(InputFile *f);
@@ -153,14 +154,19 @@ protected:
                              Filter *parm_ft, // updated
                              unsigned overlap_range, upx_compress_config_t const *cconf,
                              int filter_strategy, bool inhibit_compression_check = false);
+    // loader size of a trial in compressWithFilters(); memoized if getLoaderSizeKey() allows
+    unsigned getTrialLoaderSize(const Filter *ft);
+    // return true if the size of buildLoader(ft) only depends on ph.method,
+    // ft->id, ft->cto, ft->n_mru and *extra (and on the input file and options)
+    virtual bool getLoaderSizeKey(unsigned * /*extra*/) const { return false; }
 
     // util for verifying overlapping decompression
     //   non-destructive test
-    virtual bool testOverlappingDecompression(const byte *buf, const byte *tbuf,
-                                              unsigned overlap_overhead) const;
-    //   non-destructive find
-    virtual unsigned findOverlapOverhead(const byte *buf, const byte *tbuf, unsigned range = 0,
-                                         unsigned upper_limit = ~0u) const;
+    virtual bool testOverlappingDecompression(const PackHeader &oph, const byte *buf,
+                                              const byte *tbuf, unsigned overlap_overhead) const;
+    //   non-destructive find; uses "oph" instead of "ph"
+    virtual unsigned findOverlapOverhead(const PackHeader &oph, const byte *buf, const byte *tbuf,
+                                         unsigned range = 0, unsigned upper_limit = ~0u) const;
     //   destructive decompress + verify
     void verifyOverlappingDecompression(Filter *ft = nullptr);
     void verifyOverlappingDecompression(byte *o_ptr, unsigned o_size, Filter *ft = nullptr);
@@ -313,6 +319,24 @@ protected:
     // linker
     OwningPointer(Linker) linker = nullptr; // owner
 
+private:
+    // compress() on an explicit PackHeader; thread-safe when ui == nullptr
+    bool compress(PackHeader &cph, SPAN_P(byte) i_ptr, unsigned i_len, SPAN_P(byte) o_ptr,
+                  const upx_compress_config_t *cconf, UiPacker *ui) const;
+
+private:
+    // private to getTrialLoaderSize()
+    struct LoaderSizeMemo {
+        int method;
+        int filter;
+        int cto;
+        unsigned n_mru;
+        unsigned extra;
+        unsigned lsize;
+    };
+    LoaderSizeMemo loader_size_memo[64];
+    unsigned loader_size_memo_count = 0;
+
 private:
     // private to checkPatch()
     void *last_patch = nullptr;
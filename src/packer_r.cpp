@@ -58,9 +58,10 @@ unsigned Packer::optimizeReloc(unsigned relocnum, SPAN_P(byte) relocs, SPAN_S(by
                upx_adler32(image, image_size));
     }
 
+    const byte *const relocs_raw = raw_region(relocs, 4 * relocnum); // checked once
     unsigned pc = (unsigned) -4;
     for (unsigned i = 0; i < relocnum; i++) {
-        unsigned delta = get_le32(relocs + i * 4) - pc;
+        unsigned delta = get_le32(relocs_raw + i * 4) - pc;
         if (delta == 0)
             continue;
         else if ((int) delta < 4)
@@ -133,7 +134,8 @@ unsigned Packer::unoptimizeReloc(SPAN_S(const byte) & in, MemBuffer &out, SPAN_P
     }
 
     out.alloc(mem_size(4, relocnum + 1)); // one extra entry
-    SPAN_S_VAR(LE32, relocs, out);
+    SPAN_S_VAR(LE32, relocs_span, out);
+    LE32 *const relocs = raw_region(relocs_span, relocnum); // checked once
 
     fix = in;
     unsigned pc = (unsigned) -4;
@@ -154,7 +156,7 @@ unsigned Packer::unoptimizeReloc(SPAN_S(const byte) & in, MemBuffer &out, SPAN_P
         pc += delta;
         if (pc + 4 > image_size)
             throwCantUnpack("bad reloc[%#x] = %#x", i, pc);
-        *relocs++ = pc;
+        relocs[i] = pc;
         if (bswap) {
             if (bits == 32)
                 set_be32(image + pc, get_le32(image + pc));
@@ -163,7 +165,6 @@ unsigned Packer::unoptimizeReloc(SPAN_S(const byte) & in, MemBuffer &out, SPAN_P
         }
     }
     in = fix + 1; // advance
-    assert(relocnum == ptr_udiff_bytes(relocs, raw_bytes(out, 0)) / 4);
     if (0) {
         printf("unoptimizeReloc: u_reloc %9u checksum=0x%08x\n", 4 * relocnum,
                upx_adler32(out, 4 * relocnum));
@@ -29,6 +29,7 @@
 #include "file.h"
 #include "packmast.h"
 #include "packer.h"
+#include "ui.h"
 
 #include "lefile.h"
 #include "pefile.h"
@@ -131,13 +132,88 @@ static noinline tribool try_can_unpack(PackerBase *pb, void *user) may_throw {
 //
 **************************************************************************/
 
+/*************************************************************************
+// first-stage classifier: map the magic bytes at the start of the file
+// to the few packers that could possibly accept it, so that
+// visitAllPackers() does not need to construct and probe all of them.
+// Files without a recognized magic still visit all packers.
+**************************************************************************/
+
+/*static*/ unsigned PackMaster::classifyMagic(InputFile *f) may_throw {
+    byte buf[0x210];
+    memset(buf, 0, sizeof(buf));
+    f->seek(0, SEEK_SET);
+    (void) f->read(buf, sizeof(buf));
+    f->seek(0, SEEK_SET);
+    return classifyMagic(buf, sizeof(buf));
+}
+
+/*static*/ unsigned PackMaster::classifyMagic(const byte *buf, size_t size) noexcept {
+    assert_noexcept(size >= 0x210);
+    unsigned magic = 0;
+    const unsigned w = get_le32(buf);
+    if (memcmp(buf, "MZ", 2) == 0 || memcmp(buf, "ZM", 2) == 0)
+        magic |= MAGIC_MZ;
+    if (get_le16(buf) == 0x014c) // I386MAGIC
+        magic |= MAGIC_COFF;
+    if (get_le16(buf + 0x1fe) == 0xaa55 && memcmp(buf + 0x202, "HdrS", 4) == 0)
+        magic |= MAGIC_BOOT;
+    if (get_le32(buf + 0x24) == 0x016f2818)
+        magic |= MAGIC_ZIMAGE_ARM;
+    if (memcmp(buf, "\x7f" "ELF", 4) == 0) {
+        const unsigned e_machine = buf[5] == 2 ? get_be16(buf + 18) : get_le16(buf + 18);
+        switch (e_machine) {
+        case 3: // EM_386
+            magic |= MAGIC_ELF_386;
+            break;
+        case 62: // EM_X86_64
+            magic |= MAGIC_ELF_AMD64;
+            break;
+        case 40: // EM_ARM
+            magic |= MAGIC_ELF_ARM;
+            break;
+        case 183: // EM_AARCH64
+            magic |= MAGIC_ELF_ARM64;
+            break;
+        case 20: // EM_PPC
+        case 21: // EM_PPC64
+            magic |= MAGIC_ELF_PPC;
+            break;
+        case 8:  // EM_MIPS
+        case 10: // EM_MIPS_RS3_LE
+            magic |= MAGIC_ELF_MIPS;
+            break;
+        default:
+            magic |= MAGIC_ELF;
+            break;
+        }
+    }
+    if (memcmp(buf, "#!", 2) == 0)
+        magic |= MAGIC_SCRIPT;
+    if (w == 0x00640107 || w == 0x00640108 || w == 0x0064010b || w == 0x006400cc)
+        magic |= MAGIC_AOUT;
+    if (get_be32(buf) == 0xcafebabe) // Mach-O fat, or Java bytecode
+        magic |= MAGIC_CAFEBABE;
+    if ((w & ~1u) == 0xfeedface || (get_be32(buf) & ~1u) == 0xfeedface)
+        magic |= MAGIC_MACHO;
+    if (get_be16(buf) == 0x601a)
+        magic |= MAGIC_TOS;
+    if (memcmp(buf, "PS-X EXE", 8) == 0)
+        magic |= MAGIC_PS1;
+    if (w == 0xffffffff)
+        magic |= MAGIC_SYS;
+    return magic ? magic : MAGIC_ANY;
+}
+
 /*static*/
 PackerBase *PackMaster::visitAllPackers(visit_func_t func, InputFile *f, const Options *o,
-                                        void *user) may_throw {
-#define VISIT(Klass)                                                                               \
+                                        void *user, unsigned magic) may_throw {
+#define VISIT(Klass, klass_magic)                                                                  \
     do {                                                                                           \
         static_assert(std::is_class_v<Klass>);                                                     \
         static_assert(std::is_nothrow_destructible_v<Klass>);                                      \
+        if (!(magic & (klass_magic)))                                                              \
+            break; /* cannot accept this file */                                                   \
         auto pb = std::unique_ptr<PackerBase>(new Klass(f));                                       \
         if (o->debug.debug_level)                                                                  \
             fprintf(stderr, "visitAllPackers: (ver=%d, fmt=%3d) %s\n", pb->getVersion(),           \
@@ -150,6 +226,9 @@ PackerBase *PackMaster::visitAllPackers(visit_func_t func, InputFile *f, const O
             return nullptr; /* stop and fail early */                                              \
     } while (0)
 
+    if (o->debug.debug_level && magic != MAGIC_ANY)
+        fprintf(stderr, "visitAllPackers: magic 0x%x\n", magic);
+
     // NOTE: order of tries is important !!!
 
     //
@@ -157,97 +236,264 @@ PackerBase *PackMaster::visitAllPackers(visit_func_t func, InputFile *f, const O
     //
     if (!o->dos_exe.force_stub) {
         // dos32
-        VISIT(PackDjgpp2);
-        VISIT(PackTmt);
-        VISIT(PackWcle);
+        VISIT(PackDjgpp2, MAGIC_MZ | MAGIC_COFF);
+        VISIT(PackTmt, MAGIC_MZ);
+        VISIT(PackWcle, MAGIC_MZ);
         // Windows
-        // VISIT(PackW64PeArm64EC); // NOT YET IMPLEMENTED
-        // VISIT(PackW64PeArm64); // NOT YET IMPLEMENTED
-        VISIT(PackW64PeAmd64);
-        VISIT(PackW32PeI386);
-        VISIT(PackWinCeArm);
+        // VISIT(PackW64PeArm64EC, MAGIC_MZ); // NOT YET IMPLEMENTED
+        // VISIT(PackW64PeArm64, MAGIC_MZ); // NOT YET IMPLEMENTED
+        VISIT(PackW64PeAmd64, MAGIC_MZ);
+        VISIT(PackW32PeI386, MAGIC_MZ);
+        VISIT(PackWinCeArm, MAGIC_MZ);
     }
-    VISIT(PackExe); // dos/exe
+    VISIT(PackExe, MAGIC_MZ); // dos/exe
 
     //
     // linux kernel
     //
-    VISIT(PackVmlinuxARMEL);
-    VISIT(PackVmlinuxARMEB);
-    VISIT(PackVmlinuxPPC32);
-    VISIT(PackVmlinuxPPC64LE);
-    VISIT(PackVmlinuxAMD64);
-    VISIT(PackVmlinuxI386);
-    VISIT(PackVmlinuzI386);
-    VISIT(PackBvmlinuzI386);
-    VISIT(PackVmlinuzARMEL);
+    VISIT(PackVmlinuxARMEL, MAGIC_ELF_ARM);
+    VISIT(PackVmlinuxARMEB, MAGIC_ELF_ARM);
+    VISIT(PackVmlinuxPPC32, MAGIC_ELF_PPC);
+    VISIT(PackVmlinuxPPC64LE, MAGIC_ELF_PPC);
+    VISIT(PackVmlinuxAMD64, MAGIC_ELF_AMD64);
+    VISIT(PackVmlinuxI386, MAGIC_ELF_386);
+    VISIT(PackVmlinuzI386, MAGIC_BOOT);
+    VISIT(PackBvmlinuzI386, MAGIC_BOOT);
+    VISIT(PackVmlinuzARMEL, MAGIC_MZ | MAGIC_ZIMAGE_ARM);
 
     //
     // linux
     //
     if (!o->o_unix.force_execve) {
         if (o->o_unix.use_ptinterp) {
-            VISIT(PackLinuxElf32x86interp);
+            VISIT(PackLinuxElf32x86interp, MAGIC_ANY); // --make-ptinterp ignores the file
         }
-        VISIT(PackFreeBSDElf32x86);
-        VISIT(PackNetBSDElf32x86);
-        VISIT(PackOpenBSDElf32x86);
-        VISIT(PackLinuxElf32x86);
-        VISIT(PackLinuxElf64amd);
-        VISIT(PackLinuxElf32armLe);
-        VISIT(PackLinuxElf32armBe);
-        VISIT(PackLinuxElf64arm);
-        VISIT(PackLinuxElf32ppc);
-        VISIT(PackLinuxElf64ppc);
-        VISIT(PackLinuxElf64ppcle);
-        VISIT(PackLinuxElf32mipsel);
-        VISIT(PackLinuxElf32mipseb);
-        VISIT(PackLinuxI386sh);
+        VISIT(PackFreeBSDElf32x86, MAGIC_ELF_386);
+        VISIT(PackNetBSDElf32x86, MAGIC_ELF_386);
+        VISIT(PackOpenBSDElf32x86, MAGIC_ELF_386);
+        VISIT(PackLinuxElf32x86, MAGIC_ELF_386);
+        VISIT(PackLinuxElf64amd, MAGIC_ELF_AMD64);
+        VISIT(PackLinuxElf32armLe, MAGIC_ELF_ARM);
+        VISIT(PackLinuxElf32armBe, MAGIC_ELF_ARM);
+        VISIT(PackLinuxElf64arm, MAGIC_ELF_ARM64);
+        VISIT(PackLinuxElf32ppc, MAGIC_ELF_PPC);
+        VISIT(PackLinuxElf64ppc, MAGIC_ELF_PPC);
+        VISIT(PackLinuxElf64ppcle, MAGIC_ELF_PPC);
+        VISIT(PackLinuxElf32mipsel, MAGIC_ELF_MIPS);
+        VISIT(PackLinuxElf32mipseb, MAGIC_ELF_MIPS);
+        VISIT(PackLinuxI386sh, MAGIC_SCRIPT | MAGIC_ELF_386);
     }
-    VISIT(PackBSDI386);
-    VISIT(PackMachFat);   // cafebabe conflict
-    VISIT(PackLinuxI386); // cafebabe conflict
+    VISIT(PackBSDI386, MAGIC_EXECVE);
+    VISIT(PackMachFat, MAGIC_CAFEBABE); // cafebabe conflict
+    VISIT(PackLinuxI386, MAGIC_EXECVE); // cafebabe conflict
 
     // Mach (Darwin / macOS)
-    VISIT(PackDylibAMD64);
-    VISIT(PackMachPPC32); // TODO: this works with upx 3.91..3.94 but got broken in 3.95; FIXME
-    VISIT(PackMachI386);
-    VISIT(PackMachAMD64);
-    VISIT(PackMachARMEL);
-    VISIT(PackMachARM64EL);
+    VISIT(PackDylibAMD64, MAGIC_MACHO);
+    // TODO: this works with upx 3.91..3.94 but got broken in 3.95; FIXME
+    VISIT(PackMachPPC32, MAGIC_MACHO);
+    VISIT(PackMachI386, MAGIC_MACHO);
+    VISIT(PackMachAMD64, MAGIC_MACHO);
+    VISIT(PackMachARMEL, MAGIC_MACHO);
+    VISIT(PackMachARM64EL, MAGIC_MACHO);
 
     // 2010-03-12  omit these because PackMachBase<T>::pack4dylib (p_mach.cpp)
     // does not understand what the Darwin (Apple Mac OS X) dynamic loader
     // assumes about .dylib file structure.
-    //   VISIT(PackDylibI386);
-    //   VISIT(PackDylibPPC32);
+    //   VISIT(PackDylibI386, MAGIC_MACHO);
+    //   VISIT(PackDylibPPC32, MAGIC_MACHO);
 
     //
     // misc
     //
-    VISIT(PackTos); // atari/tos
-    VISIT(PackPs1); // ps1/exe
-    VISIT(PackSys); // dos/sys
-    VISIT(PackCom); // dos/com
+    VISIT(PackTos, MAGIC_TOS); // atari/tos
+    VISIT(PackPs1, MAGIC_PS1); // ps1/exe
+    VISIT(PackSys, MAGIC_SYS); // dos/sys
+    VISIT(PackCom, MAGIC_ANY); // dos/com has no magic
 
     return nullptr;
 #undef VISIT
 }
 
 /*static*/ PackerBase *PackMaster::getPacker(InputFile *f) may_throw {
-    PackerBase *pb = visitAllPackers(try_can_pack, f, opt, f);
+    PackerBase *pb = visitAllPackers(try_can_pack, f, opt, f, classifyMagic(f));
     if (!pb)
         throwUnknownExecutableFormat();
     return pb;
 }
 
 /*static*/ PackerBase *PackMaster::getUnpacker(InputFile *f) may_throw {
-    PackerBase *pb = visitAllPackers(try_can_unpack, f, opt, f);
+    PackerBase *pb = visitAllPackers(try_can_unpack, f, opt, f, classifyMagic(f));
     if (!pb)
         throwNotPacked();
     return pb;
 }
 
+/*************************************************************************
+// header-only inventory for "upx -l" and "upx --fileinfo"
+//
+// Instead of asking each packer in turn - canUnpack() reads large parts
+// of the file for some formats - look for the PackHeader at the few
+// places where the packers put it. The I/O per file is small and bounded,
+// which matters when scanning large collections of files. Formats with the
+// PackHeader elsewhere fall back to the usual canUnpack() probe.
+**************************************************************************/
+
+// try all "UPX!" candidates in buf[0..len); remember the first decode error
+static bool decode_pack_header(PackHeader *ph, const byte *buf, int len, char *err,
+                               size_t err_size) may_throw {
+    for (int off = 0; off + 4 <= len; off += 4) {
+        int i = find_le32(buf + off, len - off, UPX_MAGIC_LE32);
+        if (i < 0)
+            break;
+        off += i;
+        ph->reset();
+        try {
+            if (ph->decodePackHeaderFromBuf(SPAN_S_MAKE(const byte, buf + off, len - off),
+                                            len - off))
+                return true;
+        } catch (const CantUnpackException &e) {
+            if (!err[0])
+                upx_safe_snprintf(err, err_size, "%s", e.getMsg());
+        }
+    }
+    return false;
+}
+
+static bool read_pack_header(InputFile *f, upx_off_t offset, int len, PackHeader *ph, char *err,
+                             size_t err_size) may_throw {
+    if (offset < 0 || offset >= f->st_size())
+        return false;
+    MemBuffer buf(len);
+    f->seek(offset, SEEK_SET);
+    len = f->read(buf, len);
+    return len > 0 && decode_pack_header(ph, raw_bytes(buf, len), len, err, err_size);
+}
+
+/*static*/ bool PackMaster::findPackHeader(InputFile *f, PackHeader *ph, char *err,
+                                           size_t err_size) may_throw {
+    const upx_off_t file_size = f->st_size();
+    err[0] = 0;
+
+    const int head_size = (int) UPX_MIN(file_size, upx_off_t(8192));
+    MemBuffer head(head_size);
+    f->seek(0, SEEK_SET);
+    f->readx(head, head_size);
+    const byte *const h = raw_bytes(head, head_size);
+    // a fat Mach-O file ends with its last slice, whose PackHeader is in the
+    // trailer; Java class files share the magic, but have a major version >= 45
+    const bool is_fat = head_size >= 8 && get_be32(h) == 0xcafebabe && get_be32(h + 4) >= 1 &&
+                        get_be32(h + 4) < 45;
+
+    // 1) trailer: ELF, Mach-O and the other PackUnix formats; see PackUnix::canUnpack()
+    {
+        const int small = 32 + 4; // PackHeader + overlay_offset
+        int bufsize = 2 * 4096 + 2 * small + 1; // allow zero-filled last page
+        if (bufsize > file_size)
+            bufsize = (int) file_size;
+        MemBuffer buf(bufsize);
+        f->seek(-(upx_off_t) bufsize, SEEK_END);
+        f->readx(buf, bufsize);
+        int i = bufsize;
+        while (i > small && buf[--i] == 0) {
+        }
+        i -= small;
+        if (i >= 0 && decode_pack_header(ph, raw_index_bytes(buf, i, bufsize - i), bufsize - i,
+                                         err, err_size)) {
+            if (is_fat)
+                ph->format = UPX_F_MACH_FAT;
+            return true;
+        }
+    }
+
+    // 2) head: dos/com, dos/sys, dos/exe, djgpp2/coff, tmt/adam, ps1/exe, atari/tos
+    if (decode_pack_header(ph, h, head_size, err, err_size))
+        return true;
+
+    // 3) PE: just before the second section; see PeFile::canUnpack0()
+    if (head_size >= 0x40 && get_le16(h + 0) == 0x5a4d) { // "MZ"
+        const unsigned pe_offset = get_le32(h + 0x3c);
+        if (pe_offset + 24 <= (unsigned) head_size && get_le32(h + pe_offset) == 0x4550) {
+            const unsigned objs = get_le16(h + pe_offset + 6);
+            const unsigned sections = pe_offset + 24 + get_le16(h + pe_offset + 20);
+            if (objs >= 2 && sections + 40 * 3 <= (unsigned) head_size &&
+                memcmp(h + sections, "UPX", 3) == 0) {
+                // current version, then old versions
+                if (read_pack_header(f, get_le32(h + sections + 40 + 20) - upx_off_t(64), 1024,
+                                     ph, err, err_size))
+                    return true;
+                if (objs >= 3 && read_pack_header(f, get_le32(h + sections + 80 + 20), 1024,
+                                                  ph, err, err_size))
+                    return true;
+            }
+        }
+    }
+
+    // 4) linux/i386 bzImage and zImage: after the setup code; see PackVmlinuzI386
+    if (head_size >= 0x210 && get_le32(h + 0x202) == 0x53726448) { // "HdrS"
+        unsigned setup_sects = h[0x1f1] ? h[0x1f1] : 4;
+        if (read_pack_header(f, (setup_sects + 1) * upx_off_t(512), 1024, ph, err, err_size))
+            return true;
+    }
+
+    return false;
+}
+
+static tribool match_format(PackerBase *pb, void *user) {
+    return pb->getFormat() == *(const int *) user;
+}
+
+// map a UPX_F_xxx format to the name of its packer; cached, as the name
+// does not depend on the file. The names are string literals, so threads
+// which race to fill in the same entry store the same value.
+/*static*/ const char *PackMaster::getFormatName(InputFile *f, int format) may_throw {
+    static upx_std_atomic(const char *) names[256]; // nullptr: not looked up yet
+    if (format == UPX_F_DOS_EXEH)
+        format = UPX_F_DOS_EXE; // see PackExe::canUnpackFormat()
+    if (format <= 0 || format >= 256)
+        return "unknown";
+    const char *name = names[format];
+    if (name == nullptr) {
+        auto pb = std::unique_ptr<PackerBase>(visitAllPackers(match_format, f, opt, &format));
+        name = pb ? pb->getName() : "unknown";
+        names[format] = name;
+    }
+    return name;
+}
+
+void PackMaster::listHeaderOnly() may_throw {
+    PackHeader ph;
+    char err[256];
+    if (findPackHeader(fi, &ph, err, sizeof(err))) {
+        UiPacker::uiListHeaderOnly(fi, &ph, getFormatName(fi, ph.format), nullptr);
+        return;
+    }
+    // some formats keep the PackHeader elsewhere (e.g. wcle/le after the data
+    // pages, vmlinux, linux/arm zImage), so ask the packers as usual
+    try {
+        packer = visitAllPackers(try_can_unpack, fi, opt, fi, classifyMagic(fi));
+    } catch (const CantUnpackException &e) {
+        if (!err[0])
+            upx_safe_snprintf(err, sizeof(err), "%s", e.getMsg());
+    } catch (const CantPackException &e) { // e.g. PackMachFat::check_fat_head()
+        if (!err[0])
+            upx_safe_snprintf(err, sizeof(err), "%s", e.getMsg());
+    }
+    if (packer) {
+        ph = packer->ph;
+        if (packer->getFormat() == UPX_F_MACH_FAT)
+            ph.format = UPX_F_MACH_FAT; // canUnpack() leaves the format of a slice
+        UiPacker::uiListHeaderOnly(fi, &ph, packer->getName(), nullptr);
+        return;
+    }
+    if (opt->list_json || opt->cmd == CMD_FILEINFO) {
+        UiPacker::uiListHeaderOnly(fi, nullptr, nullptr, err[0] ? err : nullptr);
+        return;
+    }
+    if (err[0])
+        throwCantUnpack("%s", err);
+    throwNotPacked();
+}
+
 /*************************************************************************
 // delegation from work.cpp
 **************************************************************************/
@@ -272,18 +518,191 @@ void PackMaster::test() may_throw {
 
 void PackMaster::list() may_throw {
     assert(packer == nullptr);
+    if (opt->list_header_only) {
+        listHeaderOnly();
+        return;
+    }
     packer = getUnpacker(fi);
     packer->doList();
 }
 
 void PackMaster::fileInfo() may_throw {
     assert(packer == nullptr);
-    packer = visitAllPackers(try_can_unpack, fi, opt, fi);
+    if (opt->list_header_only) {
+        listHeaderOnly();
+        return;
+    }
+    const unsigned magic = classifyMagic(fi);
+    packer = visitAllPackers(try_can_unpack, fi, opt, fi, magic);
     if (!packer)
-        packer = visitAllPackers(try_can_pack, fi, opt, fi);
+        packer = visitAllPackers(try_can_pack, fi, opt, fi, magic);
     if (!packer)
         throwUnknownExecutableFormat(nullptr, 1); // make a warning here
     packer->doFileInfo();
 }
 
+/*************************************************************************
+// tests
+**************************************************************************/
+
+namespace {
+struct CandidateSet {
+    bool seen[256];
+    unsigned count;
+};
+} // namespace
+
+static tribool collect_format(PackerBase *pb, void *user) {
+    CandidateSet *cs = (CandidateSet *) user;
+    const int format = pb->getFormat();
+    if (format > 0 && format < 256 && !cs->seen[format]) {
+        cs->seen[format] = true;
+        cs->count += 1;
+    }
+    return false; // visit all candidates
+}
+
+static unsigned candidates(CandidateSet *cs, const byte *buf) {
+    Options o;
+    o.reset();
+    o.cmd = CMD_COMPRESS;
+    memset(cs, 0, sizeof(*cs));
+    const unsigned magic = PackMaster::classifyMagic(buf, 0x210);
+    // no InputFile: the packer constructors do not read the file then
+    PackerBase *pb = PackMaster::visitAllPackers(collect_format, nullptr, &o, cs, magic);
+    CHECK(pb == nullptr);
+    return magic;
+}
+
+TEST_CASE("PackMaster::classifyMagic") {
+    byte buf[0x210];
+    CandidateSet cs;
+
+    // dos/com has no magic: visit all packers
+    memset(buf, 0, sizeof(buf));
+    buf[0] = 0xe9; // jmp
+    CHECK(candidates(&cs, buf) == PackMaster::MAGIC_ANY);
+    const unsigned all_count = cs.count;
+    CHECK(cs.seen[UPX_F_DOS_COM]);
+    CHECK(cs.seen[UPX_F_W32PE_I386]);
+    CHECK(cs.seen[UPX_F_LINUX_ELF_i386]);
+    CHECK(cs.seen[UPX_F_MACH_FAT]);
+
+    // ELF, per e_machine
+    static const struct {
+        byte ei_data;
+        unsigned e_machine;
+        unsigned magic;
+        int format;
+        int other_format;
+    } elf[] = {
+        {1, 3, PackMaster::MAGIC_ELF_386, UPX_F_LINUX_ELF_i386, UPX_F_LINUX_ELF64_AMD64},
+        {1, 62, PackMaster::MAGIC_ELF_AMD64, UPX_F_LINUX_ELF64_AMD64, UPX_F_LINUX_ELF_i386},
+        {1, 40, PackMaster::MAGIC_ELF_ARM, UPX_F_LINUX_ELF32_ARM, UPX_F_LINUX_ELF64_ARM64},
+        {2, 40, PackMaster::MAGIC_ELF_ARM, UPX_F_LINUX_ELF32_ARMEB, UPX_F_LINUX_ELF_i386},
+        {1, 183, PackMaster::MAGIC_ELF_ARM64, UPX_F_LINUX_ELF64_ARM64, UPX_F_LINUX_ELF32_ARM},
+        {2, 20, PackMaster::MAGIC_ELF_PPC, UPX_F_LINUX_ELF32_PPC32, UPX_F_LINUX_ELF32_MIPS},
+        {2, 21, PackMaster::MAGIC_ELF_PPC, UPX_F_LINUX_ELF64_PPC64, UPX_F_LINUX_ELF32_MIPS},
+        {1, 8, PackMaster::MAGIC_ELF_MIPS, UPX_F_LINUX_ELF32_MIPSEL, UPX_F_LINUX_ELF32_PPC32},
+        {2, 8, PackMaster::MAGIC_ELF_MIPS, UPX_F_LINUX_ELF32_MIPS, UPX_F_LINUX_ELF64_PPC64},
+        {1, 2, PackMaster::MAGIC_ELF, UPX_F_LINUX_ELF_i386, UPX_F_W32PE_I386}, // EM_SPARC
+    };
+    for (size_t i = 0; i < TABLESIZE(elf); i++) {
+        memset(buf, 0, sizeof(buf));
+        memcpy(buf, "\x7f" "ELF", 4);
+        buf[5] = elf[i].ei_data;
+        if (elf[i].ei_data == 2)
+            set_be16(buf + 18, elf[i].e_machine);
+        else
+            set_le16(buf + 18, elf[i].e_machine);
+        CHECK(candidates(&cs, buf) == elf[i].magic);
+        CHECK(cs.seen[elf[i].format]);
+        CHECK(!cs.seen[elf[i].other_format]);
+        CHECK(cs.seen[UPX_F_DOS_COM]);
+        CHECK(cs.count < all_count);
+    }
+    memset(buf, 0, sizeof(buf));
+    memcpy(buf, "\x7f" "ELF", 4);
+    buf[5] = 1;
+    set_le16(buf + 18, 3);
+    (void) candidates(&cs, buf);
+    CHECK(cs.seen[UPX_F_VMLINUX_i386]);
+    CHECK(cs.seen[UPX_F_BSD_ELF_i386]);
+    CHECK(cs.seen[UPX_F_LINUX_SH_i386]);
+    CHECK(cs.seen[UPX_F_LINUX_i386]);
+
+    // dos/exe and PE
+    memset(buf, 0, sizeof(buf));
+    memcpy(buf, "MZ", 2);
+    set_le32(buf + 0x3c, 0x80);
+    memcpy(buf + 0x80, "PE\0\0", 4);
+    CHECK(candidates(&cs, buf) == PackMaster::MAGIC_MZ);
+    CHECK(cs.seen[UPX_F_DOS_EXE]);
+    CHECK(cs.seen[UPX_F_W32PE_I386]);
+    CHECK(cs.seen[UPX_F_W64PE_AMD64]);
+    CHECK(cs.seen[UPX_F_WINCE_ARM]);
+    CHECK(cs.seen[UPX_F_DJGPP2_COFF]);
+    CHECK(cs.seen[UPX_F_VMLINUZ_ARM]);
+    CHECK(!cs.seen[UPX_F_LINUX_ELF_i386]);
+    CHECK(!cs.seen[UPX_F_MACH_AMD64]);
+
+    // Mach-O, thin
+    memset(buf, 0, sizeof(buf));
+    set_le32(buf, 0xfeedfacf);
+    CHECK(candidates(&cs, buf) == PackMaster::MAGIC_MACHO);
+    CHECK(cs.seen[UPX_F_MACH_AMD64]);
+    CHECK(cs.seen[UPX_F_MACH_ARM64]);
+    CHECK(cs.seen[UPX_F_DYLIB_AMD64]);
+    CHECK(!cs.seen[UPX_F_MACH_FAT]);
+    memset(buf, 0, sizeof(buf));
+    set_be32(buf, 0xfeedface);
+    CHECK(candidates(&cs, buf) == PackMaster::MAGIC_MACHO);
+    CHECK(cs.seen[UPX_F_MACH_PPC32]);
+
+    // Mach-O, fat
+    memset(buf, 0, sizeof(buf));
+    set_be32(buf, 0xcafebabe);
+    set_be32(buf + 4, 2);
+    CHECK(candidates(&cs, buf) == PackMaster::MAGIC_CAFEBABE);
+    CHECK(cs.seen[UPX_F_MACH_FAT]);
+    CHECK(cs.seen[UPX_F_LINUX_i386]); // cafebabe conflict
+    CHECK(!cs.seen[UPX_F_MACH_AMD64]);
+
+    // linux/i386 bzImage
+    memset(buf, 0, sizeof(buf));
+    set_le16(buf + 0x1fe, 0xaa55);
+    memcpy(buf + 0x202, "HdrS", 4);
+    CHECK(candidates(&cs, buf) == PackMaster::MAGIC_BOOT);
+    CHECK(cs.seen[UPX_F_VMLINUZ_i386]);
+    CHECK(cs.seen[UPX_F_BVMLINUZ_i386]);
+    CHECK(!cs.seen[UPX_F_VMLINUX_i386]);
+    CHECK(!cs.seen[UPX_F_DOS_EXE]);
+
+    // linux/arm zImage
+    memset(buf, 0, sizeof(buf));
+    set_le32(buf + 0x24, 0x016f2818);
+    CHECK(candidates(&cs, buf) == PackMaster::MAGIC_ZIMAGE_ARM);
+    CHECK(cs.seen[UPX_F_VMLINUZ_ARM]);
+    CHECK(!cs.seen[UPX_F_VMLINUZ_i386]);
+
+    // other magics
+    memset(buf, 0, sizeof(buf));
+    memcpy(buf, "#!/bin/sh\n", 10);
+    CHECK(candidates(&cs, buf) == PackMaster::MAGIC_SCRIPT);
+    CHECK(cs.seen[UPX_F_LINUX_SH_i386]);
+    CHECK(!cs.seen[UPX_F_LINUX_ELF_i386]);
+    memset(buf, 0, sizeof(buf));
+    memcpy(buf, "PS-X EXE", 8);
+    CHECK(candidates(&cs, buf) == PackMaster::MAGIC_PS1);
+    CHECK(cs.seen[UPX_F_PS1_EXE]);
+    memset(buf, 0, sizeof(buf));
+    set_be16(buf, 0x601a);
+    CHECK(candidates(&cs, buf) == PackMaster::MAGIC_TOS);
+    CHECK(cs.seen[UPX_F_ATARI_TOS]);
+    memset(buf, 0, sizeof(buf));
+    set_le32(buf, 0xffffffff);
+    CHECK(candidates(&cs, buf) == PackMaster::MAGIC_SYS);
+    CHECK(cs.seen[UPX_F_DOS_SYS]);
+}
+
 /* vim:set ts=4 sw=4 et: */
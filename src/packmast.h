@@ -28,6 +28,7 @@
 #pragma once
 
 class PackerBase;
+struct PackHeader;
 class InputFile;
 class OutputFile;
 
@@ -46,11 +47,43 @@ public:
     void list() may_throw;
     void fileInfo() may_throw;
 
+    // candidate packers for the magic bytes of a file; see classifyMagic()
+    enum : unsigned {
+        MAGIC_MZ = 1u << 0,         // dos/exe; also the stubs of djgpp2, tmt, wcle and PE
+        MAGIC_COFF = 1u << 1,       // djgpp2 without stub
+        MAGIC_BOOT = 1u << 2,       // linux/i386 bzImage
+        MAGIC_ZIMAGE_ARM = 1u << 3, // linux/arm zImage
+        MAGIC_ELF_386 = 1u << 4,
+        MAGIC_ELF_AMD64 = 1u << 5,
+        MAGIC_ELF_ARM = 1u << 6,
+        MAGIC_ELF_ARM64 = 1u << 7,
+        MAGIC_ELF_PPC = 1u << 8, // ppc32 and ppc64
+        MAGIC_ELF_MIPS = 1u << 9,
+        MAGIC_SCRIPT = 1u << 10, // "#!"
+        MAGIC_AOUT = 1u << 11,
+        MAGIC_CAFEBABE = 1u << 12, // Mach-O fat, or Java bytecode
+        MAGIC_MACHO = 1u << 13,
+        MAGIC_TOS = 1u << 14,
+        MAGIC_PS1 = 1u << 15,
+        MAGIC_SYS = 1u << 16,
+        MAGIC_ELF = MAGIC_ELF_386 | MAGIC_ELF_AMD64 | MAGIC_ELF_ARM | MAGIC_ELF_ARM64 |
+                    MAGIC_ELF_PPC | MAGIC_ELF_MIPS,
+        MAGIC_EXECVE = MAGIC_ELF_386 | MAGIC_SCRIPT | MAGIC_AOUT | MAGIC_CAFEBABE, // linux/i386
+        MAGIC_ANY = ~0u, // unknown magic: visit all packers
+    };
+    static unsigned classifyMagic(InputFile *f) may_throw;
+    static unsigned classifyMagic(const byte *buf, size_t size) noexcept; // size >= 0x210
+
     typedef tribool (*visit_func_t)(PackerBase *pb, void *user);
     static noinline PackerBase *visitAllPackers(visit_func_t, InputFile *f, const Options *,
-                                                void *user) may_throw;
+                                                void *user, unsigned magic = MAGIC_ANY) may_throw;
+
+    // header-only inventory; see option "--header-only"
+    static bool findPackHeader(InputFile *f, PackHeader *ph, char *err, size_t err_size) may_throw;
+    static const char *getFormatName(InputFile *f, int format) may_throw;
 
 private:
+    void listHeaderOnly() may_throw;
     static PackerBase *getPacker(InputFile *f) may_throw;
     static PackerBase *getUnpacker(InputFile *f) may_throw;
 
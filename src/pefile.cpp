@@ -299,17 +299,17 @@ static constexpr size_t RELOC_ENTRY_SIZE = 5; // encoded size in bytes; actual e
 static void reloc_entry_encode(SPAN_P(byte) buf, unsigned pos, unsigned reloc_type) {
     if (reloc_type == 0 || reloc_type >= 16)
         throwCantPack("bad reloc_type %#x %u", pos, reloc_type);
-    set_ne32(buf, pos);
+    set_le32(buf, pos);
     buf[4] = (upx_uint8_t) reloc_type;
 }
 static void reloc_entry_decode(SPAN_P(const byte) buf, unsigned *pos, unsigned *reloc_type) {
-    *pos = get_ne32(buf);
+    *pos = get_le32(buf);
     *reloc_type = buf[4];
     assert(*reloc_type > 0 && *reloc_type < 16);
 }
 static int __acc_cdecl_qsort reloc_entry_compare(const void *a, const void *b) {
-    const unsigned pos1 = get_ne32(a);
-    const unsigned pos2 = get_ne32(b);
+    const unsigned pos1 = get_le32(a);
+    const unsigned pos2 = get_le32(b);
     if (pos1 != pos2)
         return pos1 < pos2 ? -1 : 1;
     const unsigned reloc_type1 = ((const byte *) a)[4];
@@ -319,6 +319,37 @@ static int __acc_cdecl_qsort reloc_entry_compare(const void *a, const void *b) {
     return 0;
 }
 
+// Relocations usually come sorted already (blocks are ordered by page, and
+// rebuildRelocs() adds sorted runs), so check that first and fall back to
+// an O(n) radix sort; the result is the same as with qsort() and the
+// respective compare function.
+static void reloc_entries_sort(byte *entries, unsigned n) {
+    for (unsigned ic = 1; ic < n; ic++)
+        if (reloc_entry_compare(entries + RELOC_ENTRY_SIZE * (ic - 1),
+                                entries + RELOC_ENTRY_SIZE * ic) > 0) {
+            // least significant first: reloc_type, then the LE32 pos
+            static const unsigned key_bytes[5] = {4, 0, 1, 2, 3};
+            upx_radix_sort(entries, n, RELOC_ENTRY_SIZE, key_bytes, 5);
+            return;
+        }
+}
+
+// sort and remove duplicates; returns the new number of entries
+static unsigned reloc_fixups_sort_unique(LE32 *fix, unsigned n) {
+    for (unsigned ic = 1; ic < n; ic++)
+        if (fix[ic - 1] > fix[ic]) {
+            static const unsigned key_bytes[4] = {0, 1, 2, 3};
+            upx_radix_sort(fix, n, sizeof(LE32), key_bytes, 4);
+            break;
+        }
+    unsigned prev = ~0u;
+    unsigned jc = 0;
+    for (unsigned kc = 0; kc < n; kc++)
+        if (fix[kc] != prev)
+            prev = fix[jc++] = fix[kc];
+    return jc;
+}
+
 PeFile::Reloc::~Reloc() noexcept {
     COMPILE_TIME_ASSERT(sizeof(BaseReloc) == 8)
     COMPILE_TIME_ASSERT_ALIGNED1(BaseReloc)
@@ -418,8 +449,8 @@ void PeFile::Reloc::add_reloc(unsigned pos, unsigned reloc_type) {
 void PeFile::Reloc::finish(byte *(&result_ptr), unsigned &result_size) {
     assert(start_did_alloc);
     // sort in-place relocs
-    upx_qsort(raw_index_bytes(start_buf, RELOC_INPLACE_OFFSET, RELOC_ENTRY_SIZE * counts[0]),
-              counts[0], RELOC_ENTRY_SIZE, reloc_entry_compare);
+    reloc_entries_sort(
+        raw_index_bytes(start_buf, RELOC_INPLACE_OFFSET, RELOC_ENTRY_SIZE * counts[0]), counts[0]);
 
     auto finish_block = [](SPAN_S(BaseReloc) rel) -> byte * {
         unsigned sob = rel->size_of_block;
@@ -534,13 +565,7 @@ void PeFile32::processRelocs() // pass1
 
     // remove duplicated records
     for (unsigned ic = 1; ic <= IMAGE_REL_BASED_HIGHLOW; ic++) {
-        upx_qsort(fix[ic], xcounts[ic], 4, le32_compare);
-        unsigned prev = ~0u;
-        unsigned jc = 0;
-        for (unsigned kc = 0; kc < xcounts[ic]; kc++)
-            if (fix[ic][kc] != prev)
-                prev = fix[ic][jc++] = fix[ic][kc];
-
+        const unsigned jc = reloc_fixups_sort_unique(fix[ic], xcounts[ic]);
         NO_printf("reloc xcounts[%u] %u->%u\n", ic, xcounts[ic], jc);
         xcounts[ic] = jc;
     }
@@ -636,13 +661,7 @@ void PeFile64::processRelocs() // pass1
 
     // remove duplicated records
     for (unsigned ic = 1; ic < 16; ic++) {
-        upx_qsort(fix[ic], xcounts[ic], 4, le32_compare);
-        unsigned prev = ~0u;
-        unsigned jc = 0;
-        for (unsigned kc = 0; kc < xcounts[ic]; kc++)
-            if (fix[ic][kc] != prev)
-                prev = fix[ic][jc++] = fix[ic][kc];
-
+        const unsigned jc = reloc_fixups_sort_unique(fix[ic], xcounts[ic]);
         NO_printf("xcounts[%u] %u->%u\n", ic, xcounts[ic], jc);
         xcounts[ic] = jc;
     }
@@ -682,58 +701,226 @@ const LE32 &PeFile::IDADDR(unsigned x) const { return iddirs[x].vaddr; }
 
  Internally it works by creating sections with special names,
  and adding relocation entries between those sections. The special
- names ensure that when the import table is built in the memory
- from those sections, a correct table can be generated simply by
- sorting the sections by name, and adding all of them to the output
- in the sorted order.
+ names ensure that a correct table is generated when all the sections
+ are added to the output sorted by name.
+
+ DLLs are interned (keyed by their lowercase name), so that the encoded
+ names are computed only once, and build() emits the sections directly
+ in name order: descriptors, thunks, dll names and proc names - each
+ group ordered by dll and then by proc. All strings and bookkeeping
+ records live in an arena which is freed as a whole.
  */
 
 class PeFile::ImportLinker final : public ElfLinkerAMD64 {
-    // temporary string owner, deletes on destruction
-    struct TStr final : private upx::noncopyable {
-        explicit TStr(char *str) noexcept : s(str) {}
-        ~TStr() noexcept { delete[] s; } // delete!
-        operator char *() noexcept { return s; }
-        operator const char *() const noexcept { return s; }
-    private:
-        char *s;
+    // bump allocator; everything is freed on destruction
+    class Arena final : private upx::noncopyable {
+        struct Chunk {
+            Chunk *next;
+            size_t size;
+        };
+        static constexpr size_t header_size = (sizeof(Chunk) + 15) & ~size_t(15);
+        Chunk *chunks = nullptr;
+        size_t used = 0; // in chunks
+    public:
+        ~Arena() noexcept {
+            while (chunks != nullptr) {
+                Chunk *next = chunks->next;
+                ::free(chunks);
+                chunks = next;
+            }
+        }
+        void *alloc(size_t len) {
+            len = (len + 15) & ~size_t(15);
+            if (chunks == nullptr || used + len > chunks->size) {
+                const size_t size = UPX_MAX(len, size_t(65536) - header_size);
+                Chunk *c = (Chunk *) ::malloc(mem_size(1, header_size + size));
+                assert(c != nullptr);
+                c->next = chunks;
+                c->size = size;
+                chunks = c;
+                used = 0;
+            }
+            void *p = (byte *) chunks + header_size + used;
+            used += len;
+            return p;
+        }
+        char *strdup(const char *s) {
+            const size_t len = strlen(s) + 1;
+            return (char *) memcpy(alloc(len), s, len);
+        }
+    };
+
+    struct Dll final {
+        Dll *next = nullptr;         // in order of addition
+        char *lname = nullptr;       // lowercase name; the interning key
+        char *hex = nullptr;         // encode_name(lname)
+        unsigned hex_len = 0;
+        unsigned order = 0;          // rank of lname; set by build()
+        Section *desc = nullptr;     // import descriptor
+        Section *name_sec = nullptr; // name of the dll
+
+        static int __acc_cdecl_qsort compare(const void *aa, const void *bb) {
+            const Dll *a = *(const Dll *const *) aa;
+            const Dll *b = *(const Dll *const *) bb;
+            return strcmp(a->lname, b->lname); // names are unique
+        }
     };
 
+    struct Thunk final {
+        Thunk *next = nullptr;      // in order of addition
+        const Dll *dll = nullptr;
+        char sep = 0;               // thunk separator; 0 for an "empty import"
+        const char *proc = nullptr; // proc name or "Hnnnnn" ordinal
+        Section *thunk = nullptr;
+        Section *hint = nullptr;    // hint and name sections, if imported by name
+        Section *pname = nullptr;
+
+        // the order of the thunk section names
+        static int __acc_cdecl_qsort compare(const void *aa, const void *bb) {
+            const Thunk *a = *(const Thunk *const *) aa;
+            const Thunk *b = *(const Thunk *const *) bb;
+            if (a->dll->order != b->dll->order)
+                return a->dll->order < b->dll->order ? -1 : 1;
+            if (a->sep != b->sep)
+                return a->sep < b->sep ? -1 : 1;
+            return strcmp(a->proc, b->proc); // names are unique within a dll
+        }
+        // the order of the proc name section names, which have no thunk separator
+        static int __acc_cdecl_qsort compare_proc(const void *aa, const void *bb) {
+            const Thunk *a = *(const Thunk *const *) aa;
+            const Thunk *b = *(const Thunk *const *) bb;
+            if (a->dll->order != b->dll->order)
+                return a->dll->order < b->dll->order ? -1 : 1;
+            return strcmp(a->proc, b->proc);
+        }
+    };
+
+    Arena arena;
+    Dll *dlls = nullptr;
+    Dll **dlls_tail = &dlls;
+    unsigned ndlls = 0;
+    Thunk *thunks = nullptr;
+    Thunk **thunks_tail = &thunks;
+    unsigned nthunks = 0;
+    // open-addressing hash table of the dlls
+    Dll **dll_hash = nullptr;
+    unsigned dll_hash_mask = 0;
+    // scratch buffer for building section names
+    mutable char *scratch = nullptr;
+    mutable size_t scratch_size = 0;
+
     // encoding of dll and proc names are required, so that our special
     // control characters in the name of sections can work as intended
-    static void encode_name(SPAN_P(const char) name, SPAN_S(char) buf) {
+    static char *encode_name(const char *name, char *buf) noexcept {
         while (*name) {
             *buf++ = 'a' + ((*name >> 4) & 0xf);
             *buf++ = 'a' + (*name & 0xf);
             name++;
         }
         *buf = 0;
+        return buf;
     }
 
-    static char *name_for_dll(const char *dll, char first_char) {
+    static unsigned hash_name(const char *name) noexcept {
+        unsigned h = 0x811c9dc5; // FNV-1a
+        for (; *name; name++)
+            h = (h ^ (uchar) *name) * 0x01000193;
+        return h;
+    }
+
+    char *get_scratch(size_t len) const {
+        if (len > scratch_size) {
+            scratch_size = UPX_MAX(len, size_t(256));
+            scratch = (char *) ::realloc(scratch, mem_size(1, scratch_size));
+            assert(scratch != nullptr);
+        }
+        return scratch;
+    }
+
+    // returns the scratch buffer; valid until the next call
+    const char *lowercase(const char *dll) const {
         assert(dll != nullptr);
-        const unsigned l = strlen(dll);
+        const size_t l = strlen(dll);
         assert(l > 0);
-        const unsigned new_size = 1 + 3 * l + 1;
-        char *const new_name = New(char, new_size);
-        SPAN_S_VAR(char, const name, new_name, new_size);
-        name[0] = first_char;
-        SPAN_S_VAR(char, n, name + (1 + 2 * l));
-        do {
-            *n++ = tolower((uchar) *dll);
-        } while (*dll++);
-        encode_name(new_name + (1 + 2 * l), name + 1);
-        return new_name;
-    }
-
-    static char *name_for_proc(const char *dll, const char *proc, char first_char, char separator) {
-        const unsigned new_size = 1 + 2 * strlen(dll) + 1 + 2 * strlen(proc) + 1 + 1;
-        TStr dll_name(name_for_dll(dll, first_char));
-        char *const new_name = New(char, new_size);
-        SPAN_S_VAR(char, const name, new_name, new_size);
-        upx_safe_snprintf(new_name, new_size, "%s%c", (const char *) dll_name, separator);
-        encode_name(proc, name + strlen(name));
-        return new_name;
+        char *const lname = get_scratch(l + 1);
+        for (size_t i = 0; i <= l; i++)
+            lname[i] = tolower((uchar) dll[i]);
+        return lname;
+    }
+
+    // section name "<id><hex(dll)>[<sep><hex(proc)>][X]" in the scratch buffer
+    const char *section_name(char id, const Dll *dll, char sep = 0, const char *proc = nullptr,
+                             bool x = false) const {
+        const size_t plen = proc ? strlen(proc) : 0;
+        char *const name = get_scratch(1 + dll->hex_len + 1 + 2 * plen + 1 + 1);
+        char *p = name;
+        *p++ = id;
+        memcpy(p, dll->hex, dll->hex_len);
+        p += dll->hex_len;
+        *p = 0;
+        if (sep) {
+            *p++ = sep;
+            p = encode_name(proc, p);
+        }
+        if (x) {
+            *p++ = 'X';
+            *p = 0;
+        }
+        return name;
+    }
+
+    Dll *find_dll(const char *dll) const {
+        if (dll_hash == nullptr)
+            return nullptr;
+        const char *lname = lowercase(dll);
+        for (unsigned i = hash_name(lname) & dll_hash_mask;; i = (i + 1) & dll_hash_mask) {
+            Dll *d = dll_hash[i];
+            if (d == nullptr || strcmp(d->lname, lname) == 0)
+                return d;
+        }
+    }
+
+    void hash_dll(Dll *d) noexcept {
+        unsigned i = hash_name(d->lname) & dll_hash_mask;
+        while (dll_hash[i] != nullptr)
+            i = (i + 1) & dll_hash_mask;
+        dll_hash[i] = d;
+    }
+
+    Dll *new_dll(const char *dll) {
+        Dll *d = new (arena.alloc(sizeof(Dll))) Dll;
+        d->lname = arena.strdup(lowercase(dll));
+        d->hex_len = 2 * strlen(d->lname);
+        d->hex = (char *) arena.alloc(d->hex_len + 1);
+        encode_name(d->lname, d->hex);
+        *dlls_tail = d;
+        dlls_tail = &d->next;
+        ndlls++;
+        if (2 * ndlls > dll_hash_mask + 1) {
+            unsigned size = 16;
+            while (size < 4 * ndlls)
+                size *= 2;
+            ::free(dll_hash);
+            dll_hash = (Dll **) ::calloc(size, sizeof(Dll *));
+            assert(dll_hash != nullptr);
+            dll_hash_mask = size - 1;
+            for (Dll *p = dlls; p != nullptr; p = p->next)
+                hash_dll(p);
+        } else
+            hash_dll(d);
+        return d;
+    }
+
+    Thunk *new_thunk(const Dll *dll, char sep, const char *proc, Section *thunk) {
+        Thunk *t = new (arena.alloc(sizeof(Thunk))) Thunk;
+        t->dll = dll;
+        t->sep = sep;
+        t->proc = arena.strdup(proc);
+        t->thunk = thunk;
+        *thunks_tail = t;
+        thunks_tail = &t->next;
+        nthunks++;
+        return t;
     }
 
     static const char zeros[sizeof(import_desc)];
@@ -755,67 +942,61 @@ class PeFile::ImportLinker final : public ElfLinkerAMD64 {
     unsigned thunk_size; // 4 or 8 bytes
 
     void add_import(const char *dll, const char *proc, unsigned ordinal) {
-        TStr sdll(name_for_dll(dll, dll_name_id));
-        TStr desc_name(name_for_dll(dll, descriptor_id));
-
+        Dll *d = find_dll(dll);
         char tsep = thunk_separator;
-        if (findSection(sdll, false) == nullptr) {
+        if (d == nullptr) {
             tsep = thunk_separator_first;
-            addSection(sdll, dll, strlen(dll) + 1, 0); // name of the dll
-            addSymbol(sdll, sdll, 0);
-
-            addSection(desc_name, zeros, sizeof(zeros), 0); // descriptor
-            addRelocation(desc_name, offsetof(import_desc, dllname), "R_X86_64_32", sdll, 0);
+            d = new_dll(dll);
+            d->name_sec = addSection(section_name(dll_name_id, d), dll, strlen(dll) + 1,
+                                     0); // name of the dll
+            addSymbol(d->name_sec->name, d->name_sec->name, 0);
+
+            d->desc = addSection(section_name(descriptor_id, d), zeros, sizeof(zeros),
+                                 0); // descriptor
+            addRelocation(d->desc->name, offsetof(import_desc, dllname), "R_X86_64_32",
+                          d->name_sec->name, 0);
         }
-        TStr thunk(proc == nullptr ? name_for_dll(dll, thunk_id)
-                                   : name_for_proc(dll, proc, thunk_id, tsep));
-
-        if (findSection(thunk, false) != nullptr)
+        const char *const tname = proc == nullptr ? section_name(thunk_id, d)
+                                                  : section_name(thunk_id, d, tsep, proc);
+        if (findSection(tname, false) != nullptr)
             return; // we already have this dll/proc
-        addSection(thunk, zeros, thunk_size, 0);
-        addSymbol(thunk, thunk, 0);
+        Section *thunk = addSection(tname, zeros, thunk_size, 0);
+        addSymbol(thunk->name, thunk->name, 0);
+        Thunk *t = new_thunk(d, proc ? tsep : 0, proc ? proc : "", thunk);
         if (tsep == thunk_separator_first) {
-            addRelocation(desc_name, offsetof(import_desc, iat), "R_X86_64_32", thunk, 0);
+            addRelocation(d->desc->name, offsetof(import_desc, iat), "R_X86_64_32", thunk->name,
+                          0);
 
-            TStr last_thunk(name_for_proc(dll, "X", thunk_id, thunk_separator_last));
-            addSection(last_thunk, zeros, thunk_size, 0);
+            Section *last_thunk = addSection(section_name(thunk_id, d, thunk_separator_last, "X"),
+                                             zeros, thunk_size, 0);
+            new_thunk(d, thunk_separator_last, "X", last_thunk);
         }
 
         const char *reltype = thunk_size == 4 ? "R_X86_64_32" : "R_X86_64_64";
         if (ordinal != 0u) {
-            addRelocation(thunk, 0, reltype, "*UND*", ordinal | (1ull << (thunk_size * 8 - 1)));
+            addRelocation(thunk->name, 0, reltype, "*UND*",
+                          ordinal | (1ull << (thunk_size * 8 - 1)));
         } else if (proc != nullptr) {
-            TStr proc_name(name_for_proc(dll, proc, proc_name_id, procname_separator));
-            addSection(proc_name, zeros, 2, 1); // 2 bytes of word aligned "hint"
-            addSymbol(proc_name, proc_name, 0);
-            addRelocation(thunk, 0, reltype, proc_name, 0);
+            t->hint = addSection(section_name(proc_name_id, d, procname_separator, proc), zeros,
+                                 2, 1); // 2 bytes of word aligned "hint"
+            addSymbol(t->hint->name, t->hint->name, 0);
+            addRelocation(thunk->name, 0, reltype, t->hint->name, 0);
 
-            strcat(proc_name, "X");
-            addSection(proc_name, proc, strlen(proc), 0); // the name of the symbol
+            t->pname = addSection(section_name(proc_name_id, d, procname_separator, proc, true),
+                                  proc, strlen(proc), 0); // the name of the symbol
         } else
             infoWarning("empty import: %s", dll);
     }
 
-    static int __acc_cdecl_qsort compare(const void *aa, const void *bb) {
-        const Section *a = *(const Section *const *) aa;
-        const Section *b = *(const Section *const *) bb;
-        if (a->sort_id == b->sort_id) // identical object, poor qsort() implementation
-            return 0;
-        int rc = strcmp(a->name, b->name);
-        if (rc != 0)
-            return rc;
-        // What could remain?
-        // make sort order deterministic
-        return a->sort_id < b->sort_id ? -1 : 1;
-    }
-
     virtual void alignCode(unsigned len) override { alignWithByte(len, 0); }
 
     const Section *getThunk(const char *dll, const char *proc, char tsep) const {
         assert(dll);
         assert(proc);
-        TStr thunk(name_for_proc(dll, proc, thunk_id, tsep));
-        return findSection(thunk, false);
+        const Dll *d = find_dll(dll);
+        if (d == nullptr)
+            return nullptr;
+        return findSection(section_name(thunk_id, d, tsep, proc), false);
     }
 
 public:
@@ -831,6 +1012,10 @@ public:
         // one trailing 00 byte after the last proc name
         addSection("Zzero", zeros, 1, 0);
     }
+    virtual ~ImportLinker() noexcept {
+        ::free(dll_hash);
+        ::free(scratch);
+    }
 
     template <typename C>
     void add_import(const C *dll, unsigned ordinal) {
@@ -858,11 +1043,45 @@ public:
         output = New(byte, output_capacity);
         outputlen = 0;
 
-        // sort the sections by name before adding them all
-        upx_qsort(sections, nsections, sizeof(Section *), ImportLinker::compare);
-
-        for (unsigned ic = 0; ic < nsections; ic++)
-            addLoader(sections[ic]->name);
+        // rank the dlls, and sort the thunks and the proc names by dll and proc
+        Array(Dll *, dll_order, ndlls + 1);
+        Array(Thunk *, thunk_order, nthunks + 1);
+        Array(Thunk *, proc_order, nthunks + 1);
+        unsigned ic = 0, nprocs = 0;
+        for (Dll *d = dlls; d != nullptr; d = d->next)
+            dll_order[ic++] = d;
+        upx_qsort(dll_order, ndlls, sizeof(Dll *), Dll::compare);
+        for (ic = 0; ic < ndlls; ic++)
+            dll_order[ic]->order = ic;
+        ic = 0;
+        for (Thunk *t = thunks; t != nullptr; t = t->next) {
+            thunk_order[ic++] = t;
+            if (t->hint != nullptr)
+                proc_order[nprocs++] = t;
+        }
+        upx_qsort(thunk_order, nthunks, sizeof(Thunk *), Thunk::compare);
+        upx_qsort(proc_order, nprocs, sizeof(Thunk *), Thunk::compare_proc);
+
+        // add all sections in the order of their names
+        addLoader("*UND*,*ZSTART");
+        for (ic = 0; ic < ndlls; ic++)
+            addLoader(dll_order[ic]->desc->name);
+        addLoader("Dzero");
+        for (ic = 0; ic < nthunks; ic++)
+            addLoader(thunk_order[ic]->thunk->name);
+        for (ic = 0; ic < ndlls; ic++)
+            addLoader(dll_order[ic]->name_sec->name);
+        for (ic = 0; ic < nprocs; ic++) {
+            addLoader(proc_order[ic]->hint->name);
+            addLoader(proc_order[ic]->pname->name);
+        }
+        addLoader("Zzero");
+#if DEBUG
+        unsigned n = 1;
+        for (const Section *s = head; s->next != nullptr; s = s->next, n++)
+            assert(strcmp(s->name, s->next->name) < 0);
+        assert(n == nsections);
+#endif
         addLoader("+40D");
         assert(outputlen <= osize);
 
@@ -904,15 +1123,16 @@ public:
     template <typename C>
     upx_uint64_t getAddress(const C *dll) const {
         ACC_COMPILE_TIME_ASSERT(sizeof(C) == 1) // "char" or "byte"
-        TStr sdll(name_for_dll((const char *) dll, dll_name_id));
-        return findSection(sdll, true)->offset;
+        const Dll *d = find_dll((const char *) dll);
+        if (d == nullptr)
+            throwInternalError("dll not found");
+        return d->name_sec->offset;
     }
 
     template <typename C>
     upx_uint64_t hasDll(const C *dll) const {
         ACC_COMPILE_TIME_ASSERT(sizeof(C) == 1) // "char" or "byte"
-        TStr sdll(name_for_dll((const char *) dll, dll_name_id));
-        return findSection(sdll, false) != nullptr;
+        return find_dll((const char *) dll) != nullptr;
     }
 };
 /*static*/ const char PeFile::ImportLinker::zeros[sizeof(import_desc)] = {0};
@@ -1916,38 +2136,49 @@ void PeFile::processResources(Resource *res) {
 
     res->init(ibuf.subref("bad res %#x", vaddr, 1));
 
-    for (soresources = res->dirsize(); res->next(); soresources += 4 + res->size())
-        ;
+    // One pass over the tree (there is no rewind() in Resource) for the size
+    // of oresources[], the icon ids in the first icon group when
+    // compress_icons == 2 and the icon id which should not be compressed
+    // when compress_icons == 1.
+    char *keep_icons = nullptr; // icon ids in the first icon group
+    upx::ArrayDeleter<char **> keep_icons_deleter{&keep_icons, 1}; // don't leak memory
+    unsigned iconsin1stdir = 0;
+    unsigned first_icon_id = (unsigned) -1;
+    unsigned nleaves = 0;
+    for (soresources = res->dirsize(); res->next(); soresources += 4 + res->size()) {
+        nleaves++;
+        if (res->itype() != RT_GROUP_ICON)
+            continue;
+        if (opt->win32_pe.compress_icons == 2 && iconsin1stdir == 0) {
+            iconsin1stdir = get_le16(ibuf.subref("bad resoff %#x", res->offs() + 4, 2));
+            delete[] keep_icons;
+            keep_icons = nullptr;
+            keep_icons = New(char, 1 + iconsin1stdir * 9);
+            *keep_icons = 0;
+            for (unsigned ic = 0; ic < iconsin1stdir; ic++)
+                upx_safe_snprintf(
+                    keep_icons + strlen(keep_icons), 9, "3/%u,",
+                    get_le16(ibuf.subref("bad resoff %#x", res->offs() + 6 + ic * 14 + 12, 2)));
+            if (*keep_icons)
+                keep_icons[strlen(keep_icons) - 1] = 0;
+        }
+        if (opt->win32_pe.compress_icons == 1 && first_icon_id == (unsigned) -1)
+            first_icon_id = get_le16(ibuf.subref("bad resoff %#x", res->offs() + 6 + 12, 2));
+    }
     mb_oresources.alloc(soresources);
     mb_oresources.clear();
     oresources = mb_oresources; // => SPAN_S
     SPAN_S_VAR(byte, ores, oresources + res->dirsize());
 
-    char *keep_icons = nullptr; // icon ids in the first icon group
-    upx::ArrayDeleter<char **> keep_icons_deleter{&keep_icons, 1}; // don't leak memory
-    unsigned iconsin1stdir = 0;
-    if (opt->win32_pe.compress_icons == 2)
-        while (res->next()) // there is no rewind() in Resource
-            if (res->itype() == RT_GROUP_ICON && iconsin1stdir == 0) {
-                iconsin1stdir = get_le16(ibuf.subref("bad resoff %#x", res->offs() + 4, 2));
-                delete[] keep_icons;
-                keep_icons = nullptr;
-                keep_icons = New(char, 1 + iconsin1stdir * 9);
-                *keep_icons = 0;
-                for (unsigned ic = 0; ic < iconsin1stdir; ic++)
-                    upx_safe_snprintf(
-                        keep_icons + strlen(keep_icons), 9, "3/%u,",
-                        get_le16(ibuf.subref("bad resoff %#x", res->offs() + 6 + ic * 14 + 12, 2)));
-                if (*keep_icons)
-                    keep_icons[strlen(keep_icons) - 1] = 0;
-            }
-
-    // the icon id which should not be compressed when compress_icons == 1
-    unsigned first_icon_id = (unsigned) -1;
-    if (opt->win32_pe.compress_icons == 1)
-        while (res->next())
-            if (res->itype() == RT_GROUP_ICON && first_icon_id == (unsigned) -1)
-                first_icon_id = get_le16(ibuf.subref("bad resoff %#x", res->offs() + 6 + 12, 2));
+    // Identical resources which are not compressed are stored only once;
+    // the tree entries of the duplicates simply share the first copy.
+    // Hash table of the newoffs() of the copies (0 means empty).
+    unsigned dup_mask = 15;
+    while (dup_mask < 2 * nleaves)
+        dup_mask = 2 * dup_mask + 1;
+    Array(unsigned, dup_offs, dup_mask + 1);
+    Array(unsigned, dup_size, dup_mask + 1);
+    memset(dup_offs, 0, mem_size(sizeof(unsigned), dup_mask + 1));
 
     bool compress_icon = opt->win32_pe.compress_icons > 1;
     bool compress_idir = opt->win32_pe.compress_icons == 3;
@@ -1957,6 +2188,8 @@ void PeFile::processResources(Resource *res) {
     unsigned csize = 0;
     unsigned unum = 0;
     unsigned cnum = 0;
+    unsigned dsize = 0;
+    unsigned dnum = 0;
 
     while (res->next()) {
         const unsigned rtype = res->itype();
@@ -1991,16 +2224,44 @@ void PeFile::processResources(Resource *res) {
             continue;
         }
 
+        const unsigned take = res->size();
+        ICHECK(ibuf + res->offs(), take);
+        const byte *const data = ibuf.subref("bad resoff %#x", res->offs(), take);
+        // icon directories may get patched below, so never share them
+        const bool dedup = rtype != RT_GROUP_ICON && take > 0;
+        unsigned dup_slot = 0;
+        if (dedup) {
+            for (dup_slot = (upx_adler32(data, take) ^ take) & dup_mask;;
+                 dup_slot = (dup_slot + 1) & dup_mask) {
+                const unsigned o = dup_offs[dup_slot];
+                if (o == 0)
+                    break;
+                if (dup_size[dup_slot] == take && memcmp(oresources + o, data, take) == 0)
+                    break;
+            }
+            if (dup_offs[dup_slot] != 0) {
+                res->newoffs() = dup_offs[dup_slot];
+                ibuf.fill(res->offs(), take, FILLVAL);
+                dsize += take;
+                dnum++;
+                if (rtype == RT_ICON && opt->win32_pe.compress_icons == 1)
+                    compress_icon = true;
+                continue;
+            }
+        }
+
         usize += res->size();
         unum++;
 
         set_le32(ores, res->offs()); // save original offset
         ores += 4;
-        const unsigned take = res->size();
-        ICHECK(ibuf + res->offs(), take);
-        memcpy(ores, ibuf.subref("bad resoff %#x", res->offs(), take), take);
+        memcpy(ores, data, take);
         ibuf.fill(res->offs(), take, FILLVAL);
         res->newoffs() = ptr_diff_bytes(ores, oresources);
+        if (dedup) {
+            dup_offs[dup_slot] = res->newoffs();
+            dup_size[dup_slot] = take;
+        }
         if (rtype == RT_ICON && opt->win32_pe.compress_icons == 1)
             compress_icon = true;
         else if (rtype == RT_GROUP_ICON) {
@@ -2023,6 +2284,8 @@ void PeFile::processResources(Resource *res) {
     }
     info("Resources: compressed %u (%u bytes), not compressed %u (%u bytes)", cnum, csize, unum,
          usize);
+    if (dnum)
+        info("Resources: %u duplicates (%u bytes) share a single copy", dnum, dsize);
 }
 
 unsigned PeFile::virta2objnum(unsigned addr, SPAN_0(pe_section_t) sect, unsigned objs) {
@@ -2229,6 +2492,8 @@ unsigned PeFile::readSections(unsigned objs, unsigned usize, unsigned ih_fileali
 }
 
 void PeFile::callCompressWithFilters(Filter &ft, int filter_strategy, unsigned ih_codebase) {
+    // the stubs decompress the image as a single stream, so it cannot be split
+    // into blocks; only several trials (--brute etc.) make use of --threads
     compressWithFilters(&ft, 2048, NULL_cconf, filter_strategy, ih_codebase, rvamin, 0, nullptr, 0);
 }
 
@@ -473,6 +473,27 @@ void UiPacker::uiPackEnd(const OutputFile *fo) {
     printSetNl(0);
 }
 
+/*static*/ void UiPacker::uiPackCached(const char *iname, const PackHeader *ph,
+                                       upx_uint64_t fc_len, const char *format_name) {
+    total_files++;
+    update_fc_len = fc_len;
+    update_fu_len = ph->u_file_size;
+    update_c_len = ph->c_len;
+    update_u_len = ph->u_len;
+
+    if (opt->verbose < 0)
+        return;
+    const char *name = iname;
+    if (opt->output_name)
+        name = opt->output_name;
+    else if (opt->to_stdout)
+        name = "<stdout>";
+    con_fprintf(stdout, "%s  [cached]\n",
+                mkline(ph->u_file_size, fc_len, ph->u_len, ph->c_len, format_name,
+                       fn_basename(name)));
+    printSetNl(0);
+}
+
 /*static*/ void UiPacker::uiPackTotal() {
     uiListTotal();
     uiFooter("Packed");
@@ -589,6 +610,72 @@ void UiPacker::uiFileInfoEnd() { uiUpdate(); }
 
 /*static*/ void UiPacker::uiFileInfoTotal() {}
 
+/*************************************************************************
+// header-only list and info; see PackMaster::listHeaderOnly()
+**************************************************************************/
+
+static const char *json_escape(char *buf, size_t size, const char *s) {
+    size_t n = 0;
+    for (; *s && n + 7 < size; s++) {
+        const unsigned char c = *s;
+        if (c == '"' || c == '\\') {
+            buf[n++] = '\\';
+            buf[n++] = c;
+        } else if (c < 0x20)
+            n += upx_safe_snprintf(buf + n, size - n, "\\u%04x", c);
+        else
+            buf[n++] = c;
+    }
+    buf[n] = 0;
+    return buf;
+}
+
+/*static*/ void UiPacker::uiListHeaderOnly(const InputFile *fi, const PackHeader *ph,
+                                           const char *format_name, const char *error) {
+    total_files++;
+    const upx_uint64_t file_size = fi->st_size();
+    if (opt->list_json) {
+        char buf[4096];
+        con_fprintf(stdout, "{\"file\":\"%s\",\"size\":%llu,\"packed\":%s",
+                    json_escape(buf, sizeof(buf), fi->getName()), file_size,
+                    ph ? "true" : "false");
+        if (ph)
+            con_fprintf(stdout,
+                        ",\"format\":\"%s\",\"format_id\":%d,\"version\":%d,\"method\":%d,"
+                        "\"level\":%d,\"filter\":%d,\"filter_cto\":%d,\"u_file_size\":%u,"
+                        "\"u_len\":%u,\"c_len\":%u",
+                        format_name, ph->format, ph->version, ph->method, ph->level, ph->filter,
+                        ph->filter_cto, ph->u_file_size, ph->u_len, ph->c_len);
+        if (error)
+            con_fprintf(stdout, ",\"error\":\"%s\"", json_escape(buf, sizeof(buf), error));
+        con_fprintf(stdout, "}\n");
+    } else if (opt->cmd == CMD_FILEINFO) {
+        int fg = con_fg(stdout, FG_CYAN);
+        con_fprintf(stdout, "%s [%s]\n", fi->getName(), ph ? format_name : "?");
+        fg = con_fg(stdout, fg);
+        UNUSED(fg);
+        con_fprintf(stdout, "  %8llu bytes", file_size);
+        if (ph)
+            con_fprintf(stdout,
+                        ", compressed by UPX %d, method %d, level %d, filter 0x%02x/0x%02x\n",
+                        ph->version, ph->method, ph->level, ph->filter, ph->filter_cto);
+        else if (error)
+            con_fprintf(stdout, ", bad UPX header: %s\n", error);
+        else
+            con_fprintf(stdout, ", not compressed by UPX\n");
+    } else {
+        assert(ph != nullptr);
+        con_fprintf(stdout, "%s\n",
+                    mkline(ph->u_file_size, file_size, ph->u_len, ph->c_len, format_name,
+                           fi->getName()));
+    }
+    printSetNl(0);
+    update_fc_len = file_size;
+    update_fu_len = ph ? ph->u_file_size : 0;
+    update_c_len = ph ? ph->c_len : 0;
+    update_u_len = ph ? ph->u_len : 0;
+}
+
 /*************************************************************************
 // util
 **************************************************************************/
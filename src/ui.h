@@ -27,8 +27,10 @@
 
 #pragma once
 
+class InputFile;
 class OutputFile;
 class PackerBase;
+struct PackHeader;
 
 /*************************************************************************
 //
@@ -43,10 +45,16 @@ public:
 
     static void uiConfirmUpdate();
     static void uiPackTotal();
+    // "upx --cache-dir": the packed file was copied from the cache
+    static void uiPackCached(const char *iname, const PackHeader *ph, upx_uint64_t fc_len,
+                             const char *format_name);
     static void uiUnpackTotal();
     static void uiListTotal(bool uncompress = false);
     static void uiTestTotal();
     static void uiFileInfoTotal();
+    // header-only "upx -l" and "upx --fileinfo"; ph == nullptr if not packed
+    static void uiListHeaderOnly(const InputFile *fi, const PackHeader *ph,
+                                 const char *format_name, const char *error);
 
     virtual void uiPackStart(const OutputFile *fo);
     virtual void uiPackEnd(const OutputFile *fo);
@@ -69,6 +69,151 @@ static bool use_simple_mcheck() noexcept {
 static forceinline constexpr bool use_simple_mcheck() noexcept { return true; }
 #endif
 
+/*************************************************************************
+// pool of large blocks
+//
+// The packers keep allocating and freeing buffers of the same few sizes:
+// ibuf/obuf for each extent, block and input file, the buffers of each
+// compression trial, etc. So large blocks are rounded up to a size class,
+// and a freed block is kept in a small pool for the next alloc() of the
+// same class. Very large blocks are mmap()ed on Linux and advised to use
+// transparent huge pages.
+// The pool is shared by all threads: upx_parallel_for() starts new worker
+// threads for every call, so per-thread pools would never be reused.
+**************************************************************************/
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#endif
+#if defined(__linux__) && defined(MAP_ANONYMOUS) && defined(MADV_HUGEPAGE)
+#define USE_POOL_MMAP 1
+#else
+#define USE_POOL_MMAP 0
+#endif
+
+namespace {
+struct BlockPool final {
+    static constexpr size_t MIN_POOLED = 64 * 1024;
+    static constexpr size_t MMAP_THRESHOLD = 32 * 1024 * 1024;
+    static constexpr size_t MAX_CACHED_BYTES = 256 * 1024 * 1024;
+    static constexpr unsigned NUM_CLASSES = 4 * 15; // 4 classes per power of 2; max 1.75 GiB
+    static constexpr unsigned SLOTS = 2;            // cached blocks per class
+
+    void *cache[NUM_CLASSES][SLOTS] = {};
+    size_t cached_bytes = 0;
+#if WITH_THREADS
+    std::mutex mutex; // protects cache[] and cached_bytes
+#endif
+
+    ~BlockPool() noexcept {
+        for (unsigned c = 0; c < NUM_CLASSES; c++)
+            for (unsigned s = 0; s < SLOTS; s++)
+                if (cache[c][s] != nullptr) {
+                    raw_free(cache[c][s], class_size(c));
+                    cache[c][s] = nullptr; // no double free by a late free()
+                }
+        cached_bytes = 0;
+    }
+
+    static size_t class_size(unsigned c) noexcept { return size_t(4 + (c & 3)) << (14 + c / 4); }
+    // return the smallest class that fits, or NUM_CLASSES if not pooled
+    static unsigned find_class(size_t bytes) noexcept {
+        if (bytes < MIN_POOLED)
+            return NUM_CLASSES;
+        for (unsigned c = 0; c < NUM_CLASSES; c++)
+            if (class_size(c) >= bytes)
+                return c;
+        return NUM_CLASSES;
+    }
+
+    static void *raw_alloc(size_t bytes) noexcept {
+#if USE_POOL_MMAP
+        if (bytes >= MMAP_THRESHOLD) {
+            void *p = ::mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS,
+                             -1, 0);
+            if (p == MAP_FAILED)
+                return nullptr;
+            (void) ::madvise(p, bytes, MADV_HUGEPAGE); // IGNORE_ERROR
+            return p;
+        }
+#endif
+        return ::malloc(bytes);
+    }
+    static void raw_free(void *p, size_t bytes) noexcept {
+#if USE_POOL_MMAP
+        if (bytes >= MMAP_THRESHOLD) {
+            (void) ::munmap(p, bytes);
+            return;
+        }
+#endif
+        UNUSED(bytes);
+        ::free(p); // NOLINT(clang-analyzer-unix.Malloc)
+    }
+
+    void *alloc(size_t bytes) noexcept {
+        const unsigned c = find_class(bytes);
+        if (c == NUM_CLASSES)
+            return ::malloc(bytes);
+        {
+#if WITH_THREADS
+            std::lock_guard<std::mutex> lock(mutex);
+#endif
+            for (unsigned s = 0; s < SLOTS; s++) {
+                void *p = cache[c][s];
+                if (p != nullptr) {
+                    cache[c][s] = nullptr;
+                    cached_bytes -= class_size(c);
+                    return p;
+                }
+            }
+        }
+        return raw_alloc(class_size(c));
+    }
+    void free(void *p, size_t bytes) noexcept {
+        const unsigned c = find_class(bytes);
+        if (c == NUM_CLASSES) {
+            ::free(p); // NOLINT(clang-analyzer-unix.Malloc)
+            return;
+        }
+        upx_uint64_t max_cached = MAX_CACHED_BYTES;
+        if (upx_get_max_memory() != 0) // the pool is resident as well
+            max_cached = UPX_MIN(max_cached, upx_get_max_memory() / 8);
+        {
+#if WITH_THREADS
+            std::lock_guard<std::mutex> lock(mutex);
+#endif
+            if (cached_bytes + class_size(c) <= max_cached) {
+                for (unsigned s = 0; s < SLOTS; s++) {
+                    if (cache[c][s] == nullptr) {
+                        cache[c][s] = p;
+                        cached_bytes += class_size(c);
+                        return;
+                    }
+                }
+            }
+        }
+        raw_free(p, class_size(c));
+    }
+};
+} // namespace
+
+static BlockPool &get_pool() noexcept {
+    static BlockPool pool;
+    return pool;
+}
+
+// a recycled block would hide a use-after-free from the sanitizers and
+// from valgrind, so the pool is only used together with the simple mcheck
+static forceinline void *pool_alloc(size_t bytes) noexcept {
+    return use_simple_mcheck() ? get_pool().alloc(bytes) : ::malloc(bytes);
+}
+static forceinline void pool_free(void *p, size_t bytes) noexcept {
+    if (use_simple_mcheck())
+        get_pool().free(p, bytes);
+    else
+        ::free(p); // NOLINT(clang-analyzer-unix.Malloc)
+}
+
 /*************************************************************************
 //
 **************************************************************************/
@@ -177,7 +322,7 @@ void MemBuffer::alloc(upx_uint64_t bytes) {
     size_t malloc_bytes = mem_size(1, bytes); // check size
     if (use_simple_mcheck())
         malloc_bytes += 32;
-    byte *p = (byte *) ::malloc(malloc_bytes);
+    byte *p = (byte *) pool_alloc(malloc_bytes);
     NO_printf("MemBuffer::alloc %llu: %p\n", bytes, p);
     if (!p)
         throwOutOfMemoryException();
@@ -232,9 +377,9 @@ void MemBuffer::dealloc() noexcept {
             set_ne32(p + size_in_bytes, 0);
             set_ne32(p + size_in_bytes + 4, 0);
             //
-            ::free(p - 16); // NOLINT(clang-analyzer-unix.Malloc) // see NOTE above
+            pool_free(p - 16, size_in_bytes + 32);
         } else {
-            ::free(ptr); // NOLINT(clang-analyzer-unix.Malloc) // see NOTE above
+            pool_free(ptr, size_in_bytes);
         }
         ptr = nullptr;
         size_in_bytes = 0;
@@ -289,6 +434,24 @@ TEST_CASE("MemBuffer core") {
     }
 }
 
+TEST_CASE("MemBuffer pool") {
+    constexpr size_t N = 1024 * 1024;
+    MemBuffer mb(N);
+    byte *const p = raw_bytes(mb, N);
+    mb.dealloc();
+    mb.alloc(N - 1000); // same size class
+    if (use_simple_mcheck())
+        CHECK(raw_bytes(mb, N - 1000) == p);
+    mb.checkState();
+    mb.fill(0, N - 1000, 0);
+    mb.dealloc();
+    mb.allocForCompression(N);
+    mb.checkState();
+    mb.dealloc();
+    mb.alloc(16);
+    mb.checkState();
+}
+
 TEST_CASE("MemBuffer global overloads") {
     MemBuffer mb(1);
     MemBuffer mb4(4);
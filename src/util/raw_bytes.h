@@ -79,4 +79,18 @@ inline T *raw_index_bytes(T (&array)[N], size_t index, size_t size_in_bytes) {
     return raw_bytes(array, mem_size(sizeof(element_type), index, size_in_bytes)) + index;
 }
 
+/*************************************************************************
+// raw_region() - validated region for hot loops: check once that "count"
+// elements are accessible, then run the loop on the returned raw pointer.
+// Works for anything that has a raw_bytes() overload.
+// The caller must stay within [result, result + count).
+// NOTE: count == number of elements, *NOT* size in bytes!
+**************************************************************************/
+
+template <class T>
+inline auto raw_region(const T &x, size_t count) -> decltype(raw_bytes(x, 0)) {
+    typedef typename std::remove_pointer<decltype(raw_bytes(x, 0))>::type element_type;
+    return raw_bytes(x, mem_size(sizeof(element_type), count));
+}
+
 /* vim:set ts=4 sw=4 et: */
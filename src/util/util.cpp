@@ -27,6 +27,10 @@
 
 #include "system_headers.h"
 #include <algorithm>
+#include <chrono>
+#if WITH_THREADS
+#include <thread>
+#endif
 #define ACC_WANT_ACC_INCI_H 1
 #include "miniacc.h"
 #define ACC_WANT_ACCLIB_GETOPT   1
@@ -371,6 +375,65 @@ void upx_shellsort_memcpy(void *array, size_t n, size_t element_size, upx_compar
         free(tmp);
 }
 
+// radix sort; used for large arrays of relocations
+void upx_radix_sort(void *array, size_t n, size_t element_size, const unsigned *key_bytes,
+                    unsigned num_key_bytes) may_throw {
+    assert(num_key_bytes <= 8);
+    if (n < 2 || num_key_bytes == 0)
+        return;
+    const size_t bytes = mem_size(element_size, n); // check size
+    for (unsigned k = 0; k < num_key_bytes; k++)
+        assert(key_bytes[k] < element_size);
+    // one histogram per key byte, all filled in a single pass
+    size_t counts[8][256];
+    memset(counts, 0, sizeof(counts[0]) * num_key_bytes);
+    const byte *p = (const byte *) array;
+    for (size_t i = 0; i < n; i++, p += element_size)
+        for (unsigned k = 0; k < num_key_bytes; k++)
+            counts[k][p[key_bytes[k]]] += 1;
+    byte *tmp = nullptr;
+    byte *src = (byte *) array;
+    for (unsigned k = 0; k < num_key_bytes; k++) {
+        const unsigned kb = key_bytes[k];
+        if (counts[k][src[kb]] == n)
+            continue; // all elements have the same key byte; nothing to do
+        if (tmp == nullptr) {
+            tmp = (byte *) malloc(bytes);
+            if (tmp == nullptr)
+                throwOutOfMemoryException();
+        }
+        byte *dst = (src == array) ? tmp : (byte *) array;
+        size_t offset = 0;
+        for (unsigned b = 0; b < 256; b++) { // counts => start offsets
+            const size_t c = counts[k][b];
+            counts[k][b] = offset;
+            offset += c;
+        }
+        p = src;
+        for (size_t i = 0; i < n; i++, p += element_size)
+            memcpy(dst + element_size * counts[k][p[kb]]++, p, element_size);
+        src = dst;
+    }
+    if (src != array)
+        memcpy(array, src, bytes);
+    free(tmp);
+}
+
+TEST_CASE("upx_radix_sort") {
+    LE32 a[1000];
+    for (unsigned i = 0; i < 1000; i++)
+        a[i] = (i * 2654435761u) ^ 0x00ff0000; // distinct values in random order
+    static const unsigned le32_key_bytes[4] = {0, 1, 2, 3};
+    upx_radix_sort(a, 1000, sizeof(LE32), le32_key_bytes, 4);
+    for (unsigned i = 1; i < 1000; i++)
+        CHECK(a[i - 1] < a[i]);
+    // stable, and the second key byte is ignored
+    byte b[6] = {2, 1, 1, 2, 1, 3};
+    static const unsigned first_key_byte[1] = {0};
+    upx_radix_sort(b, 3, 2, first_key_byte, 1);
+    CHECK((b[0] == 1 && b[1] == 2 && b[2] == 1 && b[3] == 3 && b[4] == 2 && b[5] == 1));
+}
+
 // wrap std::stable_sort()
 template <size_t ElementSize>
 void upx_std_stable_sort(void *array, size_t n, upx_compare_func_t compare) {
@@ -478,6 +541,150 @@ TEST_CASE("upx_std_stable_sort") {
 #endif // C++20
 #endif // DEBUG
 
+/*************************************************************************
+// multithreading
+**************************************************************************/
+
+// the threads and the memory of a upx_parallel_for() worker are a share of
+// those of its caller, so nested parallel work does not multiply them
+static upx_thread_local unsigned worker_num_threads = 0; // 0: not in a worker
+static upx_thread_local unsigned worker_num_sharing = 1;
+
+unsigned upx_get_num_threads() noexcept {
+#if WITH_THREADS
+    if (worker_num_threads != 0)
+        return worker_num_threads;
+    unsigned n = opt->threads;
+    if (n == 0) {
+        n = std::thread::hardware_concurrency();
+        if (n == 0)
+            n = 1;
+    }
+    return UPX_MIN(n, 64u);
+#else
+    return 1;
+#endif
+}
+
+upx_uint64_t upx_get_max_memory() noexcept { return upx_uint64_t(opt->max_memory) << 20; }
+
+unsigned upx_get_num_sharing() noexcept { return worker_num_sharing; }
+
+void upx_parallel_for(size_t n, upx_parallel_func_t func, void *user) may_throw {
+    const unsigned total_threads = upx_get_num_threads();
+    size_t num_threads = UPX_MIN(size_t(total_threads), n);
+    if (num_threads <= 1) {
+        for (size_t i = 0; i < n; i++)
+            func(user, i);
+        return;
+    }
+#if WITH_THREADS
+    const unsigned share_threads = UPX_MAX(1u, total_threads / unsigned(num_threads));
+    const unsigned share_sharing = worker_num_sharing * unsigned(num_threads);
+    std::atomic<size_t> next_index(0);
+    std::exception_ptr first_exception;
+    std::mutex exception_mutex;
+    auto worker = [&]() noexcept {
+        worker_num_threads = share_threads;
+        worker_num_sharing = share_sharing;
+        for (;;) {
+            const size_t i = next_index.fetch_add(1);
+            if (i >= n)
+                break;
+            try {
+                func(user, i);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(exception_mutex);
+                if (!first_exception)
+                    first_exception = std::current_exception();
+                next_index = n; // do not start any more work
+            }
+        }
+    };
+    std::thread threads[64];
+    size_t num_started = 1;
+    try {
+        for (; num_started < num_threads; num_started++)
+            threads[num_started] = std::thread(worker);
+    } catch (...) {
+        // std::system_error (thread limit) or std::bad_alloc: the items are
+        // taken from a shared counter, so the threads already started and the
+        // calling thread simply do all the work
+    }
+    const unsigned saved_num_threads = worker_num_threads;
+    const unsigned saved_num_sharing = worker_num_sharing;
+    worker(); // the calling thread is worker #0
+    worker_num_threads = saved_num_threads;
+    worker_num_sharing = saved_num_sharing;
+    for (size_t t = 1; t < num_started; t++)
+        threads[t].join();
+    if (first_exception)
+        std::rethrow_exception(first_exception);
+#endif
+}
+
+TEST_CASE("upx_parallel_for") {
+    unsigned a[100];
+    memset(a, 0, sizeof(a));
+    upx_parallel_for(100, [&](size_t i) { a[i] += unsigned(i) + 1; });
+    unsigned sum = 0;
+    for (size_t i = 0; i < 100; i++)
+        sum += a[i];
+    CHECK(sum == 5050);
+    CHECK_THROWS(upx_parallel_for(100, [&](size_t i) {
+        if (i == 42)
+            throwInternalError("upx_parallel_for");
+    }));
+    upx_parallel_for(0, [&](size_t) { throwInternalError("upx_parallel_for"); });
+    // nested calls share the threads of the outer one
+    const unsigned num_threads = upx_get_num_threads();
+    unsigned inner[4] = {0, 0, 0, 0};
+    upx_parallel_for(4, [&](size_t i) {
+        inner[i] = upx_get_num_threads() * upx_get_num_sharing();
+        upx_parallel_for(8, [&](size_t) {});
+    });
+    for (size_t i = 0; i < 4; i++)
+        CHECK(inner[i] <= UPX_MAX(num_threads, 4u));
+    CHECK(upx_get_num_threads() == num_threads);
+    CHECK(upx_get_num_sharing() == 1);
+}
+
+/*************************************************************************
+// time budget
+**************************************************************************/
+
+// steady clock milliseconds; 0 means no budget. The main thread sets it
+// for each file while the worker threads of the previous file may still
+// be reading it, so it is atomic.
+static upx_std_atomic(upx_uint64_t) time_budget_deadline{0};
+
+static upx_uint64_t time_budget_now() noexcept {
+    const auto t = std::chrono::steady_clock::now().time_since_epoch();
+    return (upx_uint64_t) std::chrono::duration_cast<std::chrono::milliseconds>(t).count() + 1;
+}
+
+void upx_time_budget_start() noexcept {
+    time_budget_deadline = 0;
+    if (opt->cmd == CMD_COMPRESS && opt->time_budget != 0)
+        time_budget_deadline = time_budget_now() + upx_uint64_t(opt->time_budget) * 1000;
+}
+
+bool upx_time_budget_expired() noexcept {
+    const upx_uint64_t deadline = time_budget_deadline;
+    return deadline != 0 && time_budget_now() >= deadline;
+}
+
+void upx_time_budget_check() may_throw {
+    if (opt->time_budget_hard && upx_time_budget_expired())
+        throwCantPack("time budget of %u seconds exceeded", opt->time_budget);
+}
+
+TEST_CASE("upx_time_budget") {
+    upx_time_budget_start(); // no "--time-budget=" in the tests
+    CHECK(!upx_time_budget_expired());
+    CHECK_NOTHROW(upx_time_budget_check());
+}
+
 /*************************************************************************
 // qsort() util
 **************************************************************************/
@@ -154,6 +154,11 @@ void upx_gnomesort(void *array, size_t n, size_t element_size, upx_compare_func_
 void upx_shellsort_memswap(void *array, size_t n, size_t element_size, upx_compare_func_t compare);
 void upx_shellsort_memcpy(void *array, size_t n, size_t element_size, upx_compare_func_t compare);
 
+// stable LSD radix sort by an unsigned key; key_bytes[] are the offsets of the key
+// bytes inside an element, least significant first; O(n) time and O(n) extra memory
+void upx_radix_sort(void *array, size_t n, size_t element_size, const unsigned *key_bytes,
+                    unsigned num_key_bytes) may_throw;
+
 // this wraps std::stable_sort()
 template <size_t ElementSize>
 void upx_std_stable_sort(void *array, size_t n, upx_compare_func_t compare);
@@ -168,6 +173,43 @@ void upx_std_stable_sort(void *array, size_t n, upx_compare_func_t compare);
 #define upx_qsort qsort
 #endif
 
+/*************************************************************************
+// multithreading; without WITH_THREADS everything runs serially
+**************************************************************************/
+
+// number of worker threads to use; see option "--threads="
+unsigned upx_get_num_threads() noexcept;
+// memory limit in bytes, or 0 if there is no limit; see option "--max-memory="
+upx_uint64_t upx_get_max_memory() noexcept;
+// number of upx_parallel_for() workers which share that memory; 1 outside of workers
+unsigned upx_get_num_sharing() noexcept;
+
+typedef void (*upx_parallel_func_t)(void *user, size_t index);
+
+// call func(user, i) for 0 <= i < n from up to upx_get_num_threads() threads;
+// within func, upx_get_num_threads() is the share of a single worker;
+// the first exception thrown by func is re-thrown in the calling thread
+void upx_parallel_for(size_t n, upx_parallel_func_t func, void *user) may_throw;
+
+template <class F>
+inline void upx_parallel_for(size_t n, F &&f) may_throw {
+    typedef std::remove_reference_t<F> Func;
+    upx_parallel_for(
+        n, [](void *user, size_t index) { (*static_cast<Func *>(user))(index); },
+        const_cast<void *>(static_cast<const void *>(&f)));
+}
+
+/*************************************************************************
+// time budget; see options "--time-budget=" and "--time-budget-hard"
+**************************************************************************/
+
+// start the budget of the next file; without "--time-budget=" nothing expires
+void upx_time_budget_start() noexcept;
+// true once the budget of the current file is used up; may be called by any thread
+bool upx_time_budget_expired() noexcept;
+// with "--time-budget-hard" throw a CantPackException once the budget is used up
+void upx_time_budget_check() may_throw;
+
 /*************************************************************************
 // misc support functions
 **************************************************************************/
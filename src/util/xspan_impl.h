@@ -49,7 +49,22 @@ noreturn void xspan_fail_not_same_base(void) may_throw;
 noreturn void xspan_fail_range_nullptr(void) may_throw;
 noreturn void xspan_fail_range_nullbase(void) may_throw;
 noreturn void xspan_fail_range_range(void) may_throw;
-void xspan_check_range(const void *ptr, const void *base, ptrdiff_t size_in_bytes) may_throw;
+noreturn void xspan_check_range_fail(const void *ptr, const void *base,
+                                     ptrdiff_t size_in_bytes) may_throw;
+
+// the common case is inline and branch-predicted, so that a check inside
+// a hot loop costs only a few compares; all diagnostics are out-of-line
+forceinline void xspan_check_range(const void *ptr, const void *base,
+                                   ptrdiff_t size_in_bytes) may_throw {
+    // integer arithmetic: out-of-range pointers are created deliberately during
+    // internal doctest checks (see dt_xspan.cpp), and a negative offset or size
+    // wraps around to a huge value
+    const acc_uintptr_t off = (acc_uintptr_t) ptr - (acc_uintptr_t) base;
+    if very_unlikely (ptr == nullptr || base == nullptr ||
+                      (acc_uintptr_t) size_in_bytes > (acc_uintptr_t) UPX_RSIZE_MAX ||
+                      off > (acc_uintptr_t) size_in_bytes)
+        xspan_check_range_fail(ptr, base, size_in_bytes);
+}
 
 // help constructor to distinguish between number of elements and bytes
 struct XSpanCount final {
@@ -42,6 +42,7 @@
 #endif
 #include "conf.h"
 #include "file.h"
+#include "packcache.h"
 #include "packmast.h"
 #include "ui.h"
 #include "util/membuffer.h"
@@ -329,10 +330,21 @@ void do_one_file(const char *const iname, char *const oname) may_throw {
     }
 
     // handle command - actual work starts HERE
+    upx_time_budget_start();
     PackMaster pm(&fi, opt);
-    if (opt->cmd == CMD_COMPRESS)
-        pm.pack(&fo);
-    else if (opt->cmd == CMD_DECOMPRESS)
+    PackCache cache;
+    // with "--base" the packed file also depends on the contents of another file
+    if (opt->cmd == CMD_COMPRESS && opt->cache_dir != nullptr && opt->o_unix.base == nullptr)
+        cache.open(opt->cache_dir, &fi, iname);
+    bool cache_store = false;
+    if (opt->cmd == CMD_COMPRESS) {
+        if (!cache.fetch(&fo)) {
+            // opt now points to the local options of pm
+            cache.getHint(&opt->hint_method, &opt->hint_filter);
+            pm.pack(&fo);
+            cache_store = cache.isOpen();
+        }
+    } else if (opt->cmd == CMD_DECOMPRESS)
         pm.unpack(&fo);
     else if (opt->cmd == CMD_TEST)
         pm.test();
@@ -351,6 +363,11 @@ void do_one_file(const char *const iname, char *const oname) may_throw {
     fi.closex();
     fo.closex();
 
+    // add to the cache; not possible with "--stdout", and not when
+    // "--time-budget" cut the search short
+    if (cache_store && oname[0] && !upx_time_budget_expired())
+        cache.store(oname);
+
     // rename or copy files
     if (oname[0] && !opt->output_name) {
         // both iname and oname do exist; rename oname to iname